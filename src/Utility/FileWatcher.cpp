@@ -0,0 +1,167 @@
+#include "FileWatcher.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+
+FileWatcher::FileWatcher()
+{
+#ifdef __linux__
+    inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+    close();
+}
+
+bool FileWatcher::watch(const std::string& directory)
+{
+    if (std::find(directories.begin(), directories.end(), directory) != directories.end())
+    {
+        return true;
+    }
+
+#ifdef __linux__
+    if (inotify < 0)
+    {
+        return false;
+    }
+
+    // close write rather than modify, so a file is only reported once the writer is done with it.
+    // moved to catches editors that save to a temporary and rename it over the original
+    int descriptor = inotify_add_watch(inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+
+    if (descriptor < 0)
+    {
+        return false;
+    }
+
+    watches[descriptor] = directory;
+#else
+    std::error_code error;
+
+    if (!std::filesystem::is_directory(directory, error))
+    {
+        return false;
+    }
+
+    // what's there now is the baseline, only later writes get reported
+    scan(directory, nullptr);
+#endif
+
+    directories.push_back(directory);
+    return true;
+}
+
+std::vector<std::string> FileWatcher::poll()
+{
+    std::vector<std::string> changed;
+
+#ifdef __linux__
+    if (inotify < 0)
+    {
+        return changed;
+    }
+
+    alignas(inotify_event) char buffer[4096];
+
+    while (true)
+    {
+        ssize_t length = read(inotify, buffer, sizeof(buffer));
+
+        // EAGAIN, nothing left to read
+        if (length <= 0)
+        {
+            break;
+        }
+
+        for (char* position = buffer; position < buffer + length;)
+        {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(position);
+            position += sizeof(inotify_event) + event->len;
+
+            std::unordered_map<int, std::string>::iterator directory = watches.find(event->wd);
+
+            if (directory == watches.end() || event->len == 0 || (event->mask & IN_ISDIR))
+            {
+                continue;
+            }
+
+            std::string path = directory->second + "/" + event->name;
+
+            // saving usually writes a file more than once in a row
+            if (std::find(changed.begin(), changed.end(), path) == changed.end())
+            {
+                changed.push_back(path);
+            }
+        }
+    }
+#else
+    for (const std::string& directory : directories)
+    {
+        scan(directory, &changed);
+    }
+#endif
+
+    return changed;
+}
+
+#ifndef __linux__
+void FileWatcher::scan(const std::string& directory, std::vector<std::string>* changed)
+{
+    std::error_code error;
+
+    for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(directory, error))
+    {
+        if (!entry.is_regular_file(error))
+        {
+            continue;
+        }
+
+        std::string path = directory + "/" + entry.path().filename().string();
+        std::filesystem::file_time_type writeTime = entry.last_write_time(error);
+
+        if (error)
+        {
+            continue;
+        }
+
+        std::unordered_map<std::string, std::filesystem::file_time_type>::iterator known = writeTimes.find(path);
+
+        if (known != writeTimes.end() && known->second == writeTime)
+        {
+            continue;
+        }
+
+        writeTimes[path] = writeTime;
+
+        if (changed != nullptr)
+        {
+            changed->push_back(path);
+        }
+    }
+}
+#endif
+
+void FileWatcher::close()
+{
+#ifdef __linux__
+    if (inotify >= 0)
+    {
+        ::close(inotify);
+        inotify = -1;
+    }
+
+    watches.clear();
+#else
+    writeTimes.clear();
+#endif
+
+    directories.clear();
+}
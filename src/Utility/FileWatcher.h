@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#ifndef __linux__
+#include <filesystem>
+#endif
+
+// Reports files written in a set of watched directories. On linux this is inotify, so a poll is one non blocking read.
+// Elsewhere every poll lists the directories and compares last write times, so poll it on a timer rather than every frame.
+class FileWatcher {
+
+private:
+	std::vector<std::string> directories;
+
+#ifdef __linux__
+	int inotify;
+	std::unordered_map<int, std::string> watches; // inotify watch descriptor to the directory it was added for
+#else
+	std::unordered_map<std::string, std::filesystem::file_time_type> writeTimes;
+
+	void scan(const std::string& directory, std::vector<std::string>* changed);
+#endif
+
+public:
+	FileWatcher();
+	~FileWatcher();
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	// false if the directory can't be watched. Watching the same directory twice is fine
+	bool watch(const std::string& directory);
+
+	// directory + "/" + name of every file written or moved in since the last poll, each path once
+	std::vector<std::string> poll();
+
+	void close();
+};
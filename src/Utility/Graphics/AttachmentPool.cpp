@@ -0,0 +1,127 @@
+#include "AttachmentPool.h"
+#include "DLPipeline.h"
+
+
+AttachmentPool::AttachmentPool(DLPipeline* pipeline)
+{
+    this->pipeline = pipeline;
+    attachments = std::vector<Attachment>();
+    allocation = DeviceAllocation();
+    capacity = 0;
+}
+
+AttachmentPool::~AttachmentPool()
+{
+
+}
+
+VkImage AttachmentPool::createImage(uint32_t width, uint32_t height, VkSampleCountFlagBits numSamples, VkFormat format, VkImageUsageFlags usage)
+{
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = width;
+    imageInfo.extent.height = height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT; // needed to land in lazily allocated memory
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.samples = numSamples;
+
+    Attachment attachment{};
+
+    if (vkCreateImage(pipeline->device, &imageInfo, nullptr, &attachment.image) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create image!");
+    }
+
+    vkGetImageMemoryRequirements(pipeline->device, attachment.image, &attachment.requirements);
+
+    attachments.push_back(attachment);
+
+    return attachment.image;
+}
+
+void AttachmentPool::bindImages()
+{
+    // lay the attachments out back to back, they're all in use at the same time so they can't overlap each other
+    std::vector<VkDeviceSize> offsets(attachments.size());
+
+    VkMemoryRequirements requirements{};
+    requirements.size = 0;
+    requirements.alignment = 1;
+    requirements.memoryTypeBits = UINT32_MAX;
+
+    for (int i = 0; i < attachments.size(); i++)
+    {
+        VkDeviceSize alignment = attachments[i].requirements.alignment;
+
+        offsets[i] = ((requirements.size + alignment - 1) / alignment) * alignment;
+        requirements.size = offsets[i] + attachments[i].requirements.size;
+        requirements.alignment = std::max(requirements.alignment, alignment);
+        requirements.memoryTypeBits &= attachments[i].requirements.memoryTypeBits;
+    }
+
+    if (requirements.memoryTypeBits == 0)
+    {
+        throw std::runtime_error("attachments have no memory type in common!");
+    }
+
+    // keep the old memory if the new set fits, unless the window got a lot smaller
+    bool reuse = allocation.isValid()
+        && requirements.size <= capacity
+        && requirements.size >= capacity / 4
+        && (requirements.memoryTypeBits & (1u << allocation.memoryTypeIndex))
+        && allocation.offset % requirements.alignment == 0;
+
+    if (!reuse)
+    {
+        pipeline->allocator->free(allocation);
+
+        // some headroom so dragging the window bigger doesn't reallocate on every resize
+        requirements.size += requirements.size / 4;
+
+        allocation = pipeline->allocator->allocate(requirements, MemoryUsage::TRANSIENT, AllocationKind::OPTIMAL);
+        capacity = requirements.size;
+    }
+
+    for (int i = 0; i < attachments.size(); i++)
+    {
+        if (vkBindImageMemory(pipeline->device, attachments[i].image, allocation.memory, allocation.offset + offsets[i]) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to bind image memory!");
+        }
+    }
+}
+
+void AttachmentPool::destroyImages()
+{
+    for (int i = 0; i < attachments.size(); i++)
+    {
+        vkDestroyImage(pipeline->device, attachments[i].image, nullptr);
+    }
+
+    attachments.clear();
+}
+
+void AttachmentPool::destroyAttachmentPool()
+{
+    destroyImages();
+
+    pipeline->allocator->free(allocation);
+    capacity = 0;
+}
+
+bool AttachmentPool::isLazilyAllocated()
+{
+    if (!allocation.isValid())
+    {
+        return false;
+    }
+
+    return pipeline->allocator->getMemoryProperties().memoryTypes[allocation.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdlib>
+#include <vector>
+#include <stdexcept>
+
+#include "DeviceAllocator.h"
+
+class DLPipeline;
+
+// Memory for the swap chain sized render targets (msaa color, depth). They share one allocation that outlives swap chain
+// recreation: on resize the new images are bound over the memory of the old ones if it still fits, instead of going back
+// to the allocator every time. Prefers lazily allocated memory so tilers never have to back them at all.
+class AttachmentPool {
+
+private:
+	struct Attachment {
+		VkImage image;
+		VkMemoryRequirements requirements;
+	};
+
+	DLPipeline* pipeline;
+
+	std::vector<Attachment> attachments;
+
+	DeviceAllocation allocation;
+	VkDeviceSize capacity;
+
+public:
+	AttachmentPool(DLPipeline* pipeline);
+	~AttachmentPool();
+
+	// the image has no memory until bindImages
+	VkImage createImage(uint32_t width, uint32_t height, VkSampleCountFlagBits numSamples, VkFormat format, VkImageUsageFlags usage);
+	void bindImages();
+
+	// destroys the images but keeps the memory for the next set
+	void destroyImages();
+	void destroyAttachmentPool();
+
+	VkDeviceSize getCapacity() { return capacity; }
+	bool isLazilyAllocated();
+};
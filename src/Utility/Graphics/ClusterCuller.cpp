@@ -0,0 +1,97 @@
+#include "ClusterCuller.h"
+#include "../Math/Vector3.h"
+
+#include <algorithm>
+#include <cmath>
+
+ClusterCullStats ClusterCuller::cull(const Meshlet* meshlets, uint32_t meshletCount, const Matrix4& modelView, const Matrix4& proj,
+    std::vector<VkDrawIndexedIndirectCommand>& draws)
+{
+    // appended after whatever other meshes put in there, only this mesh's own commands get merged
+    size_t firstDraw = draws.size();
+
+    ClusterCullStats stats{};
+
+    // frustum planes in view space out of the projection's rows, vulkan clip space is -w <= x, y <= w and 0 <= z <= w
+    float planes[6][4];
+    const float signs[6] = { 1.0f, -1.0f, 1.0f, -1.0f, 0.0f, -1.0f };
+    const int rows[6] = { 0, 0, 1, 1, 2, 2 };
+
+    for (int p = 0; p < 6; p++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            // the near plane is z >= 0 on its own, the rest are w plus or minus a row
+            planes[p][c] = p == 4 ? proj[c][2] : proj[c][3] + signs[p] * proj[c][rows[p]];
+        }
+
+        float length = std::sqrt(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+
+        for (int c = 0; c < 4; c++)
+        {
+            planes[p][c] /= length;
+        }
+    }
+
+    float scale = 0.0f;
+
+    for (int i = 0; i < 3; i++)
+    {
+        scale = std::max(scale, std::sqrt(modelView[i][0] * modelView[i][0] + modelView[i][1] * modelView[i][1] + modelView[i][2] * modelView[i][2]));
+    }
+
+    for (uint32_t m = 0; m < meshletCount; m++)
+    {
+        const Meshlet& meshlet = meshlets[m];
+
+        Vector3 center = modelView.transformPoint(Vector3(meshlet.center[0], meshlet.center[1], meshlet.center[2]));
+        float radius = meshlet.radius * scale;
+
+        bool outside = false;
+
+        for (int p = 0; p < 6 && !outside; p++)
+        {
+            outside = planes[p][0] * center[0] + planes[p][1] * center[1] + planes[p][2] * center[2] + planes[p][3] < -radius;
+        }
+
+        if (outside)
+        {
+            stats.frustumCulled++;
+            continue;
+        }
+
+        // the camera is at the origin, so center is also the direction to the meshlet
+        if (meshlet.coneCutoff <= 1.0f)
+        {
+            Vector3 axis = modelView.transformDirection(Vector3(meshlet.coneAxis[0], meshlet.coneAxis[1], meshlet.coneAxis[2]));
+            float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+            float distance = std::sqrt(center[0] * center[0] + center[1] * center[1] + center[2] * center[2]);
+            float dot = (center[0] * axis[0] + center[1] * axis[1] + center[2] * axis[2]) / axisLength;
+
+            if (dot >= meshlet.coneCutoff * distance + radius)
+            {
+                stats.backfaceCulled++;
+                continue;
+            }
+        }
+
+        stats.visible++;
+
+        if (draws.size() > firstDraw && draws.back().firstIndex + draws.back().indexCount == meshlet.firstIndex)
+        {
+            draws.back().indexCount += meshlet.indexCount;
+            continue;
+        }
+
+        VkDrawIndexedIndirectCommand draw{};
+        draw.indexCount = meshlet.indexCount;
+        draw.instanceCount = 1;
+        draw.firstIndex = meshlet.firstIndex;
+        draw.vertexOffset = 0;
+        draw.firstInstance = 0;
+
+        draws.push_back(draw);
+    }
+
+    return stats;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "MeshletBuilder.h"
+#include "../Math/Matrix4.h"
+
+struct ClusterCullStats {
+	uint32_t visible;
+	uint32_t frustumCulled;
+	uint32_t backfaceCulled;
+};
+
+// Per frame cpu culling of meshlets against the view frustum and their normal cones. What survives comes out as indexed draw
+// commands, with neighbouring meshlets merged into one command since they're contiguous in the index buffer.
+class ClusterCuller {
+
+public:
+	// modelView takes mesh space to view space (model * view as Matrix4 multiplies), proj is Matrix4::project's.
+	// the commands are appended to draws
+	static ClusterCullStats cull(const Meshlet* meshlets, uint32_t meshletCount, const Matrix4& modelView, const Matrix4& proj,
+		std::vector<VkDrawIndexedIndirectCommand>& draws);
+};
@@ -2,12 +2,26 @@
 
 const int MAX_FRAMES_IN_FLIGHT = 2;
 
+const VkDeviceSize STAGING_RING_SIZE = 64ull * 1024 * 1024;
+
+const double MEMORY_STATS_INTERVAL = 30.0; // seconds between device memory dumps
+const VkDeviceSize FRAME_ARENA_SIZE = 1024 * 1024; // bytes of per object data each frame can push
+const float LOD_PIXEL_ERROR = 1.0f; // how far on screen a mesh lod may be from the full mesh
+
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
 
 const std::string MODEL_PATH = "resources/models/viking_room.obj";
 const std::string TEXTURE_PATH = "resources/textures/viking_room.png";
 
+const std::string SHADER_DIRECTORY = "./src/Shaders";
+const std::string VERTEX_SHADER_PATH = SHADER_DIRECTORY + "/HelloTriangleVertex1.vert";
+const std::string FRAGMENT_SHADER_PATH = SHADER_DIRECTORY + "/HelloTriangleFragment1.frag";
+const std::string SHADER_CACHE_DIRECTORY = "resources/shadercache"; // compiled variants, named by the hash of what they were built from
+const double HOT_RELOAD_INTERVAL = 0.25; // seconds between checks for changed assets and shaders
+const std::string ARCHIVE_PATH = "resources/assets.dlpack"; // built with --pack, loose files are used without it
+const std::string PIPELINE_CACHE_PATH = "resources/pipelines.dlcache";
+
 const std::vector<const char*> validationLayers = {
     "VK_LAYER_KHRONOS_validation"
 };
@@ -18,8 +32,14 @@ const std::vector<const char*> deviceExtensions = {
 
 #ifdef NDEBUG
 const bool enableValidationLayers = false;
+const bool enableMemoryStats = false;
+const bool enableHotReload = false;
+const bool enableStartupReport = false;
 #else
 const bool enableValidationLayers = true;
+const bool enableMemoryStats = true;
+const bool enableHotReload = true;
+const bool enableStartupReport = true;
 #endif
 
 struct UniformBufferObject
@@ -33,6 +53,7 @@ struct QueueFamilyIndices
 {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    std::optional<uint32_t> transferFamily; // only set when there is a family without graphics that can copy
 
     bool isComplete()
     {
@@ -85,23 +106,13 @@ void DLPipeline::run() {
 
 uint32_t DLPipeline::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
 {
-    VkPhysicalDeviceMemoryProperties memProperties; //UPGRADEME could add memoryHeaps to more efficiently allocate memory
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
-    {
-        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
-        {
-            return i;
-        }
-    }
-
-    throw std::runtime_error("failed to find suitable memory type!");
+    // the allocator caches the memory properties, placement by usage lives there too
+    return allocator->findMemoryType(typeFilter, properties);
 }
 
 VkCommandBuffer DLPipeline::beginSingleTimeCommands()
 {
-    // UPGRADEME run all of these asynchronously with setupCommandBuffer and flushSetupCommands. Likely after texturemapping
+    // blocks until the commands are done, setup work should go through setupCommandBuffer instead
 
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -125,6 +136,10 @@ void DLPipeline::endSingleTimeCommands(VkCommandBuffer commandBuffer)
 {
     vkEndCommandBuffer(commandBuffer);
 
+    // anything still sitting in the setup buffer has to land first, acquires included
+    flushSetupCommands();
+    uploadContext->waitIdle();
+
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submitInfo.commandBufferCount = 1;
@@ -136,6 +151,29 @@ void DLPipeline::endSingleTimeCommands(VkCommandBuffer commandBuffer)
     vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 }
 
+VkCommandBuffer DLPipeline::setupCommandBuffer()
+{
+    return uploadContext->getCommandBuffer();
+}
+
+VkCommandBuffer DLPipeline::setupGraphicsCommandBuffer()
+{
+    return uploadContext->getGraphicsCommandBuffer();
+}
+
+VkFence DLPipeline::flushSetupCommands()
+{
+    VkFence fence = uploadContext->flush();
+
+    // staged data read by the setup commands is released once they're done
+    if (fence != VK_NULL_HANDLE)
+    {
+        stagingRing->submitUploads(uploadContext->getSubmittedValue());
+    }
+
+    return fence;
+}
+
 void DLPipeline::initWindow()
 {
     glfwInit();
@@ -146,40 +184,92 @@ void DLPipeline::initWindow()
 }
 
 void DLPipeline::initVulkan() {
-    createInstance();
-    setupDebugMessenger();
-    createSurface();
-    pickPhysicalDevice();
-    createLogicalDevice();
-    createSwapChain();
-    createImageViews();
-    createRenderPass();
-    createDescriptorSetLayout();
-    createGraphicsPipeline();
-    createCommandPool();
-    createColorResources();
-    createDepthResources();
-    createFramebuffers();
-    createTextureImage();
-    createTextureImageView();
-    createTextureSampler();
-    loadModel();
-    createVertexAndIndexBuffers();
-    createUniformBuffers();
-    createDescriptorPool();
-    createDescriptorSets();
-    createCommandBuffers();
-    createSyncObjects();
+    createVirtualFileSystem();
+    createThreadPool();
+    createShaderCompiler();
+    createPipelineRegistry();
+
+    // Steps that record setup commands, allocate device memory or talk to the window system stay on the main thread, in
+    // the order they always ran in. Creating objects from the device alone is thread safe, and reading the scene's assets
+    // needs no device at all, so those run on the pool meanwhile
+    JobGraph startup;
+    VertexFormat sceneFormat{};
+
+    JobId instanceStep = startup.add("createInstance", JobThread::MAIN, [this]() { createInstance(); });
+    JobId debugMessengerStep = startup.add("setupDebugMessenger", JobThread::MAIN, [this]() { setupDebugMessenger(); }, { instanceStep });
+    JobId surfaceStep = startup.add("createSurface", JobThread::MAIN, [this]() { createSurface(); }, { debugMessengerStep });
+    JobId physicalDeviceStep = startup.add("pickPhysicalDevice", JobThread::MAIN, [this]() { pickPhysicalDevice(); }, { surfaceStep });
+    JobId logicalDeviceStep = startup.add("createLogicalDevice", JobThread::MAIN, [this]() { createLogicalDevice(); }, { physicalDeviceStep });
+    JobId allocatorStep = startup.add("createAllocator", JobThread::MAIN, [this]() { createAllocator(); }, { logicalDeviceStep });
+    JobId stagingRingStep = startup.add("createStagingRing", JobThread::MAIN, [this]() { createStagingRing(); }, { allocatorStep });
+    JobId uploadContextStep = startup.add("createUploadContext", JobThread::MAIN, [this]() { createUploadContext(); }, { stagingRingStep });
+    JobId attachmentPoolStep = startup.add("createAttachmentPool", JobThread::MAIN, [this]() { createAttachmentPool(); }, { uploadContextStep });
+    JobId swapChainStep = startup.add("createSwapChain", JobThread::MAIN, [this]() { createSwapChain(); }, { attachmentPoolStep });
+    JobId imageViewsStep = startup.add("createImageViews", JobThread::MAIN, [this]() { createImageViews(); }, { swapChainStep });
+    JobId renderPassStep = startup.add("createRenderPass", JobThread::MAIN, [this]() { createRenderPass(); }, { imageViewsStep });
+    JobId commandPoolStep = startup.add("createCommandPool", JobThread::MAIN, [this]() { createCommandPool(); }, { renderPassStep });
+    JobId colorResourcesStep = startup.add("createColorResources", JobThread::MAIN, [this]() { createColorResources(); }, { commandPoolStep });
+    JobId depthResourcesStep = startup.add("createDepthResources", JobThread::MAIN, [this]() { createDepthResources(); }, { colorResourcesStep });
+    JobId attachmentViewsStep = startup.add("createAttachmentViews", JobThread::MAIN, [this]() { createAttachmentViews(); }, { depthResourcesStep });
+    JobId framebuffersStep = startup.add("createFramebuffers", JobThread::MAIN, [this]() { createFramebuffers(); }, { attachmentViewsStep });
+    JobId textureLoaderStep = startup.add("createTextureLoader", JobThread::MAIN, [this]() { createTextureLoader(); }, { framebuffersStep });
+    JobId uniformBuffersStep = startup.add("createUniformBuffers", JobThread::MAIN, [this]() { createUniformBuffers(); }, { textureLoaderStep });
+
+    JobId descriptorSetLayoutStep = startup.add("createDescriptorSetLayout", JobThread::WORKER, [this]() { createDescriptorSetLayout(); }, { logicalDeviceStep });
+    JobId pipelineLayoutStep = startup.add("createPipelineLayout", JobThread::WORKER, [this]() { createPipelineLayout(); }, { descriptorSetLayoutStep });
+    JobId textureSamplerStep = startup.add("createTextureSampler", JobThread::WORKER, [this]() { createTextureSampler(); }, { logicalDeviceStep });
+    JobId syncObjectsStep = startup.add("createSyncObjects", JobThread::WORKER, [this]() { createSyncObjects(); }, { logicalDeviceStep });
+    JobId pipelineCacheStep = startup.add("createPipelineCache", JobThread::WORKER, [this]() { createPipelineCache(); }, { logicalDeviceStep });
+
+    // the scene's obj is imported and its texture baked while the device comes up, createScene then only maps the results.
+    // Compression support decides what the texture is baked to
+    JobId sceneMeshesStep = startup.add("prepareSceneMeshes", JobThread::WORKER,
+        [this, &sceneFormat]() { sceneFormat = ResourceManager::prepareMesh(MODEL_PATH, vfs, threadPool); });
+    JobId sceneTexturesStep = startup.add("prepareSceneTextures", JobThread::WORKER,
+        [this]() { TextureLoader::prepare(TEXTURE_PATH, textureCompressionEnabled, vfs); }, { logicalDeviceStep });
+    JobId scenePipelinesStep = startup.add("createScenePipelines", JobThread::WORKER,
+        [this, &sceneFormat]() { pipelines->build(getPipelineState(sceneFormat)); }, { renderPassStep, pipelineLayoutStep, pipelineCacheStep, sceneMeshesStep });
+
+    JobId resourceManagerStep = startup.add("createResourceManager", JobThread::MAIN, [this]() { createResourceManager(); },
+        { uniformBuffersStep, descriptorSetLayoutStep, textureSamplerStep });
+    JobId fileWatcherStep = startup.add("createFileWatcher", JobThread::MAIN, [this]() { createFileWatcher(); }, { resourceManagerStep });
+    JobId sceneStep = startup.add("createScene", JobThread::MAIN, [this]() { createScene(); }, { fileWatcherStep, sceneTexturesStep, scenePipelinesStep });
+    startup.add("createCommandBuffers", JobThread::MAIN, [this]() { createCommandBuffers(); }, { sceneStep, syncObjectsStep });
+
+    startup.run(threadPool);
+
+    if (enableStartupReport)
+    {
+        startup.printReport(std::cout);
+    }
+
+    flushSetupCommands();
+
+    // the placeholder texture is bound from the first frame on, and the scene is better shown complete than popping in
+    uploadContext->waitIdle();
 }
 
 void DLPipeline::mainLoop() {
     long elapsed_sec = 0;
+    double lastMemoryStats = glfwGetTime();
     while (!glfwWindowShouldClose(window))
     {
         long loop_start = clock();
         glfwPollEvents();
         drawFrame();
 
+        if (enableMemoryStats && glfwGetTime() - lastMemoryStats > MEMORY_STATS_INTERVAL)
+        {
+            allocator->printStats(std::cout);
+            std::cout << "scene: " << models.size() << " models, " << resources->getMeshCount() << " meshes, "
+                << resources->getMaterialCount() << " textures, " << resources->getFreeVertexSize() << " vertex and "
+                << resources->getFreeIndexSize() << " index bytes free in " << resources->getGeometryBlockCount() << " geometry blocks" << std::endl;
+            std::cout << "meshlets: " << meshletStats.visible << " visible, " << meshletStats.frustumCulled
+                << " outside the frustum, " << meshletStats.backfaceCulled << " back facing, " << modelDraws.size() << " models drawn with "
+                << meshletDraws.size() << " draws" << std::endl;
+            lastMemoryStats = glfwGetTime();
+        }
+
         //elapsed_sec = (clock() - loop_start) / CLOCKS_PER_SEC;
         //frames_per_second = 1 / elapsed_sec;
         //printf("%f\n", (float)elapsed_sec);
@@ -192,24 +282,40 @@ void DLPipeline::cleanup() {
 
     cleanupSwapChain();
 
+    models.clear();
+
+    resources->destroyResourceManager();
+    delete resources;
+
     vkDestroySampler(device, textureSampler, nullptr);
-    vkDestroyImageView(device, textureImageView, nullptr);
 
-    vkDestroyImage(device, textureImage, nullptr);
-    textureImageMemory->destroyMemoryPool();
-    delete textureImageMemory;
+    textureLoader->destroyTextureLoader();
+    delete textureLoader;
+
+    threadPool->destroyThreadPool();
+    delete threadPool;
+
+    // nothing may still be reading out of the archive's mapping
+    vfs->unmount();
+    delete vfs;
 
 
-    uniformBufferMemoryPool->destroyMemoryPool();
-    delete uniformBufferMemoryPool;
+    frameArena->destroyFrameArena();
+    delete frameArena;
 
-    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
     vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
-    vertexAndIndexBufferMemory->destroyMemoryPool();
-    delete vertexAndIndexBufferMemory;
+    // the pool is gone, so no compile is still running
+    pipelines->destroyPipelineRegistry();
+    delete pipelines;
+
+    delete shaderCompiler;
+
+    pipelineCache->destroyPipelineCache();
+    delete pipelineCache;
+
+    fileWatcher.close();
 
-    vkDestroyPipeline(device, graphicsPipeline, nullptr);
     vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
     vkDestroyRenderPass(device, renderPass, nullptr);
 
@@ -222,6 +328,18 @@ void DLPipeline::cleanup() {
 
     vkDestroyCommandPool(device, commandPool, nullptr);
 
+    uploadContext->destroyUploadContext();
+    delete uploadContext;
+
+    attachmentPool->destroyAttachmentPool();
+    delete attachmentPool;
+
+    stagingRing->destroyStagingRing();
+    delete stagingRing;
+
+    allocator->destroyAllocator();
+    delete allocator;
+
     vkDestroyDevice(device, nullptr);
 
     if (enableValidationLayers)
@@ -242,6 +360,27 @@ void DLPipeline::drawFrame()
 {
     vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
 
+    // before the fence is reset further down, after that the ring couldn't tell this frame from the next one
+    stagingRing->completeFrame(inFlightFences[currentFrame]);
+
+    uploadContext->retire();
+    stagingRing->retire();
+
+    // the gpu is done with everything this frame pushed last time around
+    frameArena->beginFrame(currentFrame);
+
+    // at the frame boundary, nothing recorded yet uses what a reload replaces
+    if (enableHotReload)
+    {
+        hotReload();
+    }
+
+    // pipelines that finished compiling are drawn with from this frame on
+    pipelines->update();
+
+    // this frame's descriptor sets are idle now, so textures that became resident can be swapped in
+    resources->update(currentFrame);
+
     uint32_t imageIndex;
 
     VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
@@ -258,6 +397,9 @@ void DLPipeline::drawFrame()
 
     updateUniformBuffer(currentFrame);
 
+    // uploads recorded since the last frame go ahead of it on the queue
+    flushSetupCommands();
+
     // Only reset fence if we submit work!
     vkResetFences(device, 1, &inFlightFences[currentFrame]);
 
@@ -268,6 +410,7 @@ void DLPipeline::drawFrame()
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
+    // meshes and textures are only drawn once their uploads have finished, so the frame doesn't wait on them
     VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
     VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
     submitInfo.waitSemaphoreCount = 1;
@@ -286,6 +429,9 @@ void DLPipeline::drawFrame()
         throw std::runtime_error("failed to submit draw command buffer!");
     }
 
+    // anything staged while building this frame is free again once the frame is done
+    stagingRing->submitFrame(inFlightFences[currentFrame]);
+
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
@@ -322,12 +468,137 @@ void DLPipeline::updateUniformBuffer(uint32_t currentImage)
 
     float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 
-    UniformBufferObject ubo{};
-    ubo.model = Matrix4::axisAngle(Vector3::FORWARDS, time * PI / 2.0f);
-    ubo.view = Matrix4::lookAt(Vector3(2.0f, 2.0f, 2.0f), Vector3::ZERO, Vector3::FORWARDS);
-    ubo.proj = Matrix4::project(PI / 4.0f, swapChainExtent.width / (float)swapChainExtent.height, 0.1f, 10.0f);
+    Matrix4 spin = Matrix4::axisAngle(Vector3::FORWARDS, time * PI / 2.0f);
+    Matrix4 view = Matrix4::lookAt(Vector3(2.0f, 2.0f, 2.0f), Vector3::ZERO, Vector3::FORWARDS);
+    Matrix4 proj = Matrix4::project(PI / 4.0f, swapChainExtent.width / (float)swapChainExtent.height, 0.1f, 10.0f);
+
+    modelDraws.clear();
+    meshletDraws.clear();
+    meshletStats = ClusterCullStats{};
+
+    for (uint32_t i = 0; i < models.size(); i++)
+    {
+        const GpuMesh* mesh = resources->getMesh(models[i].mesh);
+
+        // still uploading, the model shows up once its geometry is in
+        if (mesh == nullptr || !resources->isMeshReady(models[i].mesh))
+        {
+            continue;
+        }
+
+        VkPipeline graphicsPipeline = pipelines->get(getGraphicsPipeline(mesh->format));
+
+        // still compiling, the model shows up once it's ready instead of the frame waiting for it
+        if (graphicsPipeline == VK_NULL_HANDLE)
+        {
+            continue;
+        }
+
+        // the arena is full for this frame, the remaining models are dropped rather than the frame failing
+        if (frameArena->getAvailable() < sizeof(UniformBufferObject))
+        {
+            break;
+        }
+
+        // every model spins in place wherever it was put
+        Matrix4 model = spin * models[i].transform;
+
+        const MeshLod& lod = mesh->lods[selectMeshLod(*mesh, model, view, proj)];
+
+        ModelDraw draw{};
+        draw.model = i;
+        draw.firstDraw = static_cast<uint32_t>(meshletDraws.size());
+
+        ClusterCullStats stats = ClusterCuller::cull(mesh->meshlets.data() + lod.firstMeshlet, lod.meshletCount, model * view, proj, meshletDraws);
+        meshletStats.visible += stats.visible;
+        meshletStats.frustumCulled += stats.frustumCulled;
+        meshletStats.backfaceCulled += stats.backfaceCulled;
 
-    uniformBufferMemoryPool->copyToMappedBuffer(uniformBufferMemoryPool->getBuffer(currentImage), &ubo, sizeof(UniformBufferObject));
+        draw.drawCount = static_cast<uint32_t>(meshletDraws.size()) - draw.firstDraw;
+
+        if (draw.drawCount == 0)
+        {
+            continue;
+        }
+
+        UniformBufferObject ubo{};
+        ubo.model = VertexPacker::positionTransform(mesh->format) * model;
+        ubo.view = view;
+        ubo.proj = proj;
+
+        draw.pipeline = graphicsPipeline;
+        draw.uniformOffset = frameArena->push(&ubo, sizeof(UniformBufferObject));
+
+        modelDraws.push_back(draw);
+    }
+}
+
+void DLPipeline::hotReload()
+{
+    if (glfwGetTime() - lastHotReload < HOT_RELOAD_INTERVAL)
+    {
+        return;
+    }
+
+    lastHotReload = glfwGetTime();
+
+    for (const std::string& path : fileWatcher.poll())
+    {
+        // recompiled on the pool, the old pipelines are drawn with until the new ones are in
+        if (pipelines->rebuild(path))
+        {
+            std::cout << "shader reload: " << path << std::endl;
+            continue;
+        }
+
+        // the mesh cache and baked textures are written next to their sources, those aren't loaded by path
+        resources->reload(path);
+    }
+}
+
+uint32_t DLPipeline::selectMeshLod(const GpuMesh& mesh, const Matrix4& model, const Matrix4& view, const Matrix4& proj)
+{
+    // bounding sphere of the mesh in view space, scaled by the largest axis of the model matrix
+    Vector3 center;
+    float diagonal = 0.0f;
+
+    for (int c = 0; c < 3; c++)
+    {
+        center[c] = 0.5f * (mesh.boundsMin[c] + mesh.boundsMax[c]);
+        diagonal += (mesh.boundsMax[c] - mesh.boundsMin[c]) * (mesh.boundsMax[c] - mesh.boundsMin[c]);
+    }
+
+    Vector3 viewCenter = view.transformPoint(model.transformPoint(center));
+
+    float scale = 0.0f;
+
+    for (int i = 0; i < 3; i++)
+    {
+        scale = std::max(scale, std::sqrt(model[i][0] * model[i][0] + model[i][1] * model[i][1] + model[i][2] * model[i][2]));
+    }
+
+    float radius = 0.5f * std::sqrt(diagonal) * scale;
+
+    // the camera looks down -z, a sphere reaching the camera gets the full mesh
+    float distance = -viewCenter[2] - radius;
+
+    if (distance <= 0.0f)
+    {
+        return 0;
+    }
+
+    // proj[1][1] is the focal length, so this is how many pixels one unit covers at that distance
+    float pixelsPerUnit = std::fabs(proj[1][1]) * 0.5f * swapChainExtent.height / distance;
+
+    for (uint32_t i = mesh.lodCount - 1; i > 0; i--)
+    {
+        if (mesh.lods[i].error * scale * pixelsPerUnit <= LOD_PIXEL_ERROR)
+        {
+            return i;
+        }
+    }
+
+    return 0;
 }
 
 void DLPipeline::createInstance()
@@ -344,7 +615,7 @@ void DLPipeline::createInstance()
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "DLEngine";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    appInfo.apiVersion = VK_API_VERSION_1_2; // timeline semaphores for the transfer queue
 
     // global extensions and validation layers (not optional)
     VkInstanceCreateInfo createInfo{};
@@ -454,6 +725,14 @@ void DLPipeline::createLogicalDevice()
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
 
+    // the upload handoff between queues needs timeline semaphores, without them everything stays on the graphics queue
+    asyncTransfer = indices.transferFamily.has_value() && checkTimelineSemaphoreSupport(physicalDevice);
+
+    if (asyncTransfer)
+    {
+        uniqueQueueFamilies.insert(indices.transferFamily.value());
+    }
+
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies)
     {
@@ -470,6 +749,19 @@ void DLPipeline::createLogicalDevice()
     deviceFeatures.samplerAnisotropy = VK_TRUE;
     deviceFeatures.sampleRateShading = VK_TRUE;
 
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
+    textureCompressionEnabled = supportedFeatures.textureCompressionBC == VK_TRUE;
+    deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+    multiDrawIndirectEnabled = supportedFeatures.multiDrawIndirect == VK_TRUE;
+    deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+    maxDrawIndirectCount = multiDrawIndirectEnabled ? deviceProperties.limits.maxDrawIndirectCount : 1;
+
     // device create info
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -478,8 +770,27 @@ void DLPipeline::createLogicalDevice()
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pEnabledFeatures = &deviceFeatures;
 
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    timelineFeatures.timelineSemaphore = VK_TRUE;
+
+    if (asyncTransfer)
+    {
+        createInfo.pNext = &timelineFeatures;
+    }
+
+    // budget numbers are nice to have, the allocator estimates without them
+    std::vector<const char*> enabledExtensions = deviceExtensions;
+    memoryBudgetEnabled = deviceProperties.apiVersion >= VK_API_VERSION_1_1
+        && isDeviceExtensionAvailable(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+    if (memoryBudgetEnabled)
+    {
+        enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+    createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
     if (enableValidationLayers)
     {
@@ -498,6 +809,69 @@ void DLPipeline::createLogicalDevice()
 
     vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
     vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+
+    if (asyncTransfer)
+    {
+        vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
+    }
+    else
+    {
+        transferQueue = graphicsQueue;
+    }
+}
+
+void DLPipeline::createVirtualFileSystem()
+{
+    vfs = new VirtualFileSystem();
+
+    if (vfs->mount(ARCHIVE_PATH))
+    {
+        std::cout << "mounted " << ARCHIVE_PATH << std::endl;
+    }
+}
+
+void DLPipeline::createPipelineCache()
+{
+    pipelineCache = new PipelineCache(this, PIPELINE_CACHE_PATH);
+}
+
+void DLPipeline::createThreadPool()
+{
+    threadPool = new ThreadPool();
+}
+
+void DLPipeline::createShaderCompiler()
+{
+    shaderCompiler = new ShaderCompiler(vfs, SHADER_CACHE_DIRECTORY);
+}
+
+void DLPipeline::createPipelineRegistry()
+{
+    pipelines = new PipelineRegistry(this, threadPool, MAX_FRAMES_IN_FLIGHT);
+}
+
+void DLPipeline::createAllocator()
+{
+    allocator = new DeviceAllocator(this);
+}
+
+void DLPipeline::createStagingRing()
+{
+    stagingRing = new StagingRing(this, STAGING_RING_SIZE);
+}
+
+void DLPipeline::createUploadContext()
+{
+    QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+
+    uint32_t transferFamily = asyncTransfer ? indices.transferFamily.value() : indices.graphicsFamily.value();
+
+    uploadContext = new UploadContext(this, graphicsQueue, indices.graphicsFamily.value(), transferQueue, transferFamily);
+}
+
+void DLPipeline::createAttachmentPool()
+{
+    attachmentPool = new AttachmentPool(this);
 }
 
 void DLPipeline::createSwapChain()
@@ -620,7 +994,7 @@ void DLPipeline::createRenderPass()
     colorAttachment.format = swapChainImageFormat;
     colorAttachment.samples = msaaSamples;
     colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE; // only the resolve target is read after the pass
 
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
@@ -682,113 +1056,110 @@ void DLPipeline::createRenderPass()
     }
 }
 
-void DLPipeline::createDescriptorPool()
+void DLPipeline::createPipelineLayout()
 {
-    std::array<VkDescriptorPoolSize, 2> poolSizes{};
-    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-    poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-
-
-    VkDescriptorPoolCreateInfo poolInfo{};
-    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-    poolInfo.pPoolSizes = poolSizes.data();
-    poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
 
-    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
     {
-        throw std::runtime_error("failed to create descriptor pool!");
+        throw std::runtime_error("failed to create pipeline layout");
     }
 }
 
-void DLPipeline::createDescriptorSets()
+PipelineState DLPipeline::getPipelineState(const VertexFormat& format)
 {
-    std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
-    VkDescriptorSetAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = descriptorPool;
-    allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-    allocInfo.pSetLayouts = layouts.data();
-
+    PipelineState state{};
+    state.vertexShader = VERTEX_SHADER_PATH;
+    state.fragmentShader = FRAGMENT_SHADER_PATH;
+    state.format = format;
+    state.blendEnable = true;
+    state.depthTest = true;
+    state.depthWrite = true;
+    state.cullMode = VK_CULL_MODE_BACK_BIT;
+    state.samples = msaaSamples;
+
+    return state;
+}
 
-    descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
-    if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS)
+PipelineId DLPipeline::getGraphicsPipeline(const VertexFormat& format)
+{
+    for (const std::pair<VertexFormat, PipelineId>& formatPipeline : formatPipelines)
     {
-        throw std::runtime_error("failed to allocate descriptor sets!");
+        if (VertexPacker::sameLayout(formatPipeline.first, format))
+        {
+            return formatPipeline.second;
+        }
     }
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-    {
-        VkDescriptorBufferInfo bufferInfo{};
-        bufferInfo.buffer = uniformBuffers[i]->buffer;
-        bufferInfo.offset = 0;
-        bufferInfo.range = sizeof(UniformBufferObject);
-
-        VkDescriptorImageInfo imageInfo{};
-        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageInfo.imageView = textureImageView;
-        imageInfo.sampler = textureSampler;
-
-        std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
-        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[0].dstSet = descriptorSets[i];
-        descriptorWrites[0].dstBinding = 0;
-        descriptorWrites[0].dstArrayElement = 0;
-        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        descriptorWrites[0].descriptorCount = 1;
-        descriptorWrites[0].pBufferInfo = &bufferInfo;
-        descriptorWrites[0].pImageInfo = nullptr; //optional
-        descriptorWrites[0].pTexelBufferView = nullptr; //optional
-
-        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[1].dstSet = descriptorSets[i];
-        descriptorWrites[1].dstBinding = 1;
-        descriptorWrites[1].dstArrayElement = 0;
-        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptorWrites[1].descriptorCount = 1;
-        descriptorWrites[1].pImageInfo = &imageInfo;
+    PipelineId id = pipelines->request(getPipelineState(format));
+    formatPipelines.push_back(std::make_pair(format, id));
 
-        vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
-    }
+    return id;
 }
 
-void DLPipeline::createGraphicsPipeline()
+VkPipeline DLPipeline::createGraphicsPipeline(const PipelineState& state)
 {
-    std::vector<char> vertShaderCode = readFile("./src/Shaders/HelloTriangleVertex1.spv");
-    std::vector<char> fragShaderCode = readFile("./src/Shaders/HelloTriangleFragment1.spv");
+    // out of the shader cache, or compiled into these when the variant is new
+    MappedFile vertFile;
+    MappedFile fragFile;
+    std::vector<uint32_t> vertCompiled;
+    std::vector<uint32_t> fragCompiled;
+    FileView vertShaderCode = shaderCompiler->load(state.vertexShader, state.defines, vertFile, vertCompiled);
+    FileView fragShaderCode = shaderCompiler->load(state.fragmentShader, state.defines, fragFile, fragCompiled);
+
+    if (!vertShaderCode.isValid() || !fragShaderCode.isValid())
+    {
+        throw std::runtime_error("failed to open " + (vertShaderCode.isValid() ? state.fragmentShader : state.vertexShader));
+    }
 
     VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
     VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
 
+    // constant_id i is specialization[i] in both stages
+    std::vector<VkSpecializationMapEntry> specializationEntries(state.specialization.size());
+
+    for (uint32_t i = 0; i < specializationEntries.size(); i++)
+    {
+        specializationEntries[i].constantID = i;
+        specializationEntries[i].offset = i * sizeof(uint32_t);
+        specializationEntries[i].size = sizeof(uint32_t);
+    }
+
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+    specializationInfo.pMapEntries = specializationEntries.data();
+    specializationInfo.dataSize = state.specialization.size() * sizeof(uint32_t);
+    specializationInfo.pData = state.specialization.data();
+
     VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
     vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
     vertShaderStageInfo.module = vertShaderModule;
     vertShaderStageInfo.pName = "main";
-    // can use pSpecializationInfo for shader constants
-    vertShaderStageInfo.pSpecializationInfo = nullptr;
+    vertShaderStageInfo.pSpecializationInfo = state.specialization.empty() ? nullptr : &specializationInfo;
 
     VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
     fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
     fragShaderStageInfo.module = fragShaderModule;
     fragShaderStageInfo.pName = "main";
-    fragShaderStageInfo.pSpecializationInfo = nullptr;
+    fragShaderStageInfo.pSpecializationInfo = state.specialization.empty() ? nullptr : &specializationInfo;
 
     VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
     // we could make a dynamic pipeline via VkPipelineDynamicStateCreateInfo
 
-    VkVertexInputBindingDescription bindingDescription = Vertex::getBindingDescription();
-    std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions = Vertex::getAttributeDescriptions();
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions = VertexPacker::getBindingDescriptions(state.format);
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions = VertexPacker::getAttributeDescriptions(state.format);
 
 
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
     vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
     vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data(); // return to this later
 
@@ -799,8 +1170,8 @@ void DLPipeline::createGraphicsPipeline()
 
     VkPipelineDepthStencilStateCreateInfo depthStencil{};
     depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    depthStencil.depthTestEnable = VK_TRUE;
-    depthStencil.depthWriteEnable = VK_TRUE;
+    depthStencil.depthTestEnable = state.depthTest ? VK_TRUE : VK_FALSE;
+    depthStencil.depthWriteEnable = state.depthWrite ? VK_TRUE : VK_FALSE;
     depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
     depthStencil.depthBoundsTestEnable = VK_FALSE;
     depthStencil.minDepthBounds = 0.0f; // optional
@@ -822,14 +1193,14 @@ void DLPipeline::createGraphicsPipeline()
     rasterizer.rasterizerDiscardEnable = VK_FALSE;
     rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
     rasterizer.lineWidth = 1.0f;
-    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizer.cullMode = state.cullMode;
     rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
     rasterizer.depthBiasEnable = VK_FALSE;
 
     VkPipelineMultisampleStateCreateInfo multisampling{};
     multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
     multisampling.sampleShadingEnable = VK_TRUE;
-    multisampling.rasterizationSamples = msaaSamples;
+    multisampling.rasterizationSamples = state.samples;
     //implied/optional
     multisampling.minSampleShading = 0.2f; // closer to 1 is smoother. Tune graphics?
     multisampling.pSampleMask = nullptr;
@@ -838,7 +1209,7 @@ void DLPipeline::createGraphicsPipeline()
 
     VkPipelineColorBlendAttachmentState colorBlendAttachment{};
     colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    colorBlendAttachment.blendEnable = VK_TRUE; //BLEND ALPHA
+    colorBlendAttachment.blendEnable = state.blendEnable ? VK_TRUE : VK_FALSE; //BLEND ALPHA
     //implied/optional. enable blending above, and change settings below
     colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
     colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
@@ -868,16 +1239,6 @@ void DLPipeline::createGraphicsPipeline()
     dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
     dynamicState.pDynamicStates = dynamicStates.data();
 
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-
-    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
-    {
-        throw std::runtime_error("failed to create pipeline layout");
-    }
-
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     pipelineInfo.stageCount = 2;
@@ -897,13 +1258,19 @@ void DLPipeline::createGraphicsPipeline()
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
     pipelineInfo.basePipelineIndex = -1;
 
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
+    VkPipeline graphicsPipeline;
+    VkResult result = vkCreateGraphicsPipelines(device, pipelineCache->getCache(), 1, &pipelineInfo, nullptr, &graphicsPipeline);
+
+    vkDestroyShaderModule(device, fragShaderModule, nullptr);
+    vkDestroyShaderModule(device, vertShaderModule, nullptr);
+
+    // a shader reload survives a broken shader, so nothing is left behind
+    if (result != VK_SUCCESS)
     {
         throw std::runtime_error("failed to create graphics pipeline!");
     }
 
-    vkDestroyShaderModule(device, fragShaderModule, nullptr);
-    vkDestroyShaderModule(device, vertShaderModule, nullptr);
+    return graphicsPipeline;
 }
 
 void DLPipeline::createFramebuffers()
@@ -945,50 +1312,9 @@ void DLPipeline::createCommandPool()
     }
 }
 
-void DLPipeline::createVertexAndIndexBuffers()
-{
-    vertexAndIndexBufferMemory = new MemoryPool(this);
-
-    vertexBuffer = new MPBuffer();
-    indexBuffer = new MPBuffer();
-
-    vertexBuffer->createNewBuffer(this, sizeof(vertices[0]) * vertices.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-    indexBuffer->createNewBuffer(this, sizeof(indices[0]) * indices.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
-
-    vertexAndIndexBufferMemory->addBuffer(vertexBuffer);
-    vertexAndIndexBufferMemory->addBuffer(indexBuffer);
-
-    vertexAndIndexBufferMemory->solidifyMemoryPool(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-    vertexAndIndexBufferMemory->copyMemory(vertices.data(), vertexBuffer, sizeof(vertices[0]) * vertices.size());
-    vertexAndIndexBufferMemory->copyMemory(indices.data(), indexBuffer, sizeof(indices[0]) * indices.size());
-
-    vertexAndIndexBufferMemory->convertStagedMemory(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-}
-
 void DLPipeline::createUniformBuffers()
 {
-    VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-
-    uniformBufferMemoryPool = new MemoryPool(this);
-
-    uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-    uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
-
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-    {
-        MPBuffer* uniformBuffer = new MPBuffer();
-        uniformBuffer->createNewBuffer(this, bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
-        uniformBuffers[i] = uniformBuffer;
-        uniformBufferMemoryPool->addBuffer(uniformBuffer);
-    }
-
-    uniformBufferMemoryPool->solidifyMemoryPool(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-    uniformBufferMemoryPool->mapMemory();
+    frameArena = new FrameArena(this, FRAME_ARENA_SIZE, MAX_FRAMES_IN_FLIGHT);
 }
 
 void DLPipeline::createCommandBuffers()
@@ -1035,7 +1361,7 @@ void DLPipeline::createDescriptorSetLayout()
 {
     VkDescriptorSetLayoutBinding uboLayoutBinding{};
     uboLayoutBinding.binding = 0;
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     uboLayoutBinding.descriptorCount = 1;
     uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     uboLayoutBinding.pImmutableSamplers = nullptr; // optional
@@ -1061,55 +1387,122 @@ void DLPipeline::createDescriptorSetLayout()
     }
 }
 
-void DLPipeline::createTextureImage()
+void DLPipeline::createTextureLoader()
+{
+    // decoded off the main thread, frames sample a placeholder until they're resident
+    textureLoader = new TextureLoader(this, threadPool);
+}
+
+void DLPipeline::createResourceManager()
+{
+    resources = new ResourceManager(this, threadPool, textureLoader, descriptorSetLayout, textureSampler, frameArena->getBuffer(),
+        sizeof(UniformBufferObject), MAX_FRAMES_IN_FLIGHT);
+}
+
+void DLPipeline::createFileWatcher()
 {
-    int texWidth, texHeight, texChannels;
-    stbi_uc* pixels = stbi_load(TEXTURE_PATH.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+    if (enableHotReload && !fileWatcher.watch(SHADER_DIRECTORY))
+    {
+        std::cerr << SHADER_DIRECTORY << ": can't watch for changes" << std::endl;
+    }
+}
 
-    mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+void DLPipeline::createScene()
+{
+    addModel(MODEL_PATH, TEXTURE_PATH, Matrix4::IDENTITY);
+}
 
-    VkDeviceSize imageSize = texWidth * texHeight * 4;
+ModelHandle DLPipeline::addModel(const std::string& meshPath, const std::string& texturePath, const Matrix4& transform)
+{
+    Model model{};
+    model.mesh = resources->loadMesh(meshPath);
+    model.material = resources->loadMaterial(texturePath);
+    model.transform = transform;
 
-    if (!pixels)
+    if (enableHotReload)
     {
-        throw std::runtime_error("failed to load texture image!");
+        fileWatcher.watch(std::filesystem::path(meshPath).parent_path().string());
+        fileWatcher.watch(std::filesystem::path(texturePath).parent_path().string());
     }
 
-    //FIXME should not be using memory pool abstraction! Just use VkMemory instead
-    textureImageMemory = new MemoryPool(this);
-    MemoryPool stagingPool = MemoryPool(this);
+    // compiles on the pool if the layout is new, the model is drawn once it's ready
+    getGraphicsPipeline(resources->getMesh(model.mesh)->format);
 
+    return models.insert(model);
+}
 
-    MPBuffer* stagingBuffer = new MPBuffer();
-    stagingBuffer->createNewBuffer(this, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+void DLPipeline::removeModel(ModelHandle handle)
+{
+    Model* model = models.get(handle);
 
-    stagingPool.addBuffer(stagingBuffer);
+    if (model == nullptr)
+    {
+        return;
+    }
 
-    stagingPool.solidifyMemoryPool(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    resources->releaseMesh(model->mesh);
+    resources->releaseMaterial(model->material);
 
-    void* data;
-    vkMapMemory(device, stagingPool.getMemory(), 0, imageSize, 0, &data);
-    memcpy(data, pixels, static_cast<size_t>(imageSize));
-    vkUnmapMemory(device, stagingPool.getMemory());
-    stbi_image_free(pixels);
+    models.remove(handle);
+}
 
-    createImage(texWidth, texHeight, mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
-        VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        textureImage, textureImageMemory->getMemory());
+void DLPipeline::uploadTexture(const void* pixels, uint32_t width, uint32_t height, uint32_t mipLevels, VkImage& image, DeviceAllocation& imageAllocation)
+{
+    createImage(width, height, mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, MemoryUsage::GPU_ONLY,
+        image, imageAllocation);
 
-    transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED,
+    transitionImageLayout(image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED,
         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
-    copyBufferToImage(stagingBuffer->buffer, textureImage, static_cast<uint32_t>(texWidth),
-        static_cast<uint32_t>(texHeight));
+    copyToImage((const unsigned char*)pixels, image, 0, width, height, 1, (VkDeviceSize)width * 4);
 
-    generateMipmaps(textureImage, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, mipLevels);
+    // the blits need a graphics queue, hand the whole mip chain over
+    VkImageSubresourceRange mipRange{};
+    mipRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    mipRange.baseMipLevel = 0;
+    mipRange.levelCount = mipLevels;
+    mipRange.baseArrayLayer = 0;
+    mipRange.layerCount = 1;
 
+    uploadContext->releaseImage(image, mipRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
 
-    stagingPool.destroyMemoryPool();
+    generateMipmaps(image, VK_FORMAT_R8G8B8A8_SRGB, width, height, mipLevels);
+}
+
+void DLPipeline::uploadBakedTexture(const BakedTexture& texture, VkImage& image, DeviceAllocation& imageAllocation)
+{
+    uint32_t mipLevels = static_cast<uint32_t>(texture.mips.size());
+
+    createImage(texture.width, texture.height, mipLevels, VK_SAMPLE_COUNT_1_BIT, texture.format, VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, MemoryUsage::GPU_ONLY, image, imageAllocation);
+
+    transitionImageLayout(image, texture.format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+
+    // a row of blocks at a time for compressed formats, the ring's 16 byte alignment covers both block sizes
+    uint32_t rowHeight = TextureBaker::isCompressed(texture.format) ? 4 : 1;
+
+    for (uint32_t i = 0; i < mipLevels; i++)
+    {
+        const BakedMip& mip = texture.mips[i];
+        uint32_t rowCount = (mip.height + rowHeight - 1) / rowHeight;
+
+        copyToImage(texture.data.data() + mip.offset, image, i, mip.width, mip.height, rowHeight, mip.size / rowCount);
+    }
+
+    VkImageSubresourceRange mipRange{};
+    mipRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    mipRange.baseMipLevel = 0;
+    mipRange.levelCount = mipLevels;
+    mipRange.baseArrayLayer = 0;
+    mipRange.layerCount = 1;
+
+    uploadContext->releaseImage(image, mipRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
 }
 
 void DLPipeline::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling,
-    VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory)
+    VkImageUsageFlags usage, MemoryUsage memoryUsage, VkImage& image, DeviceAllocation& imageAllocation)
 {
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -1132,31 +1525,16 @@ void DLPipeline::createImage(uint32_t width, uint32_t height, uint32_t mipLevels
         throw std::runtime_error("failed to create image!");
     }
 
-    VkMemoryRequirements memRequirements;
-    vkGetImageMemoryRequirements(device, image, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits,
-        properties);
-
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
-    {
-        throw std::runtime_error("failed to allocate image memory!");
-    }
-
-    vkBindImageMemory(device, image, imageMemory, 0);
+    imageAllocation = allocator->allocateForImage(image, tiling, memoryUsage);
 }
 
 void DLPipeline::createDepthResources()
 {
     VkFormat depthFormat = findDepthFormat();
 
-    createImage(swapChainExtent.width, swapChainExtent.height, 1, msaaSamples, depthFormat, VK_IMAGE_TILING_OPTIMAL,
-        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory);
-
-    depthImageView = createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+    // depth is cleared on load and never stored, so it can be transient too
+    depthImage = attachmentPool->createImage(swapChainExtent.width, swapChainExtent.height, msaaSamples, depthFormat,
+        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
 
     //transitionImageLayout(depthImage, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
 }
@@ -1206,6 +1584,25 @@ SwapChainSupportDetails DLPipeline::querySwapChainSupport(VkPhysicalDevice physi
     return details;
 }
 
+bool DLPipeline::isDeviceExtensionAvailable(VkPhysicalDevice physicalDevice, const char* extensionName)
+{
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+    for (const VkExtensionProperties& extension : availableExtensions)
+    {
+        if (strcmp(extension.extensionName, extensionName) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 bool DLPipeline::checkDeviceExtensionSupport(VkPhysicalDevice physicalDevice)
 {
     uint32_t extensionCount;
@@ -1328,7 +1725,7 @@ QueueFamilyIndices DLPipeline::findQueueFamilies(VkPhysicalDevice physicalDevice
     int index = 0;
     for (const VkQueueFamilyProperties& queueFamily : queueFamilies)
     {
-        if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+        if (!indices.graphicsFamily.has_value() && (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT))
         {
             indices.graphicsFamily = index;
         }
@@ -1336,22 +1733,61 @@ QueueFamilyIndices DLPipeline::findQueueFamilies(VkPhysicalDevice physicalDevice
         VkBool32 presentSupport = false;
         vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, index, surface, &presentSupport);
 
-        if (presentSupport)
+        if (!indices.presentFamily.has_value() && presentSupport)
         {
             indices.presentFamily = index;
         }
 
-        if (indices.isComplete())
+        index++;
+    }
+
+    // uploads prefer a transfer only family (dma engine), then async compute. compute queues can always copy
+    index = 0;
+    for (const VkQueueFamilyProperties& queueFamily : queueFamilies)
+    {
+        bool graphics = queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+        bool compute = queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT;
+        bool transfer = queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT;
+
+        if (!graphics && !compute && transfer)
         {
+            indices.transferFamily = index;
             break;
         }
 
+        if (!graphics && compute && !indices.transferFamily.has_value())
+        {
+            indices.transferFamily = index;
+        }
+
         index++;
     }
 
     return indices;
 }
 
+bool DLPipeline::checkTimelineSemaphoreSupport(VkPhysicalDevice physicalDevice)
+{
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+    if (deviceProperties.apiVersion < VK_API_VERSION_1_2)
+    {
+        return false;
+    }
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &timelineFeatures;
+
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+    return timelineFeatures.timelineSemaphore == VK_TRUE;
+}
+
 VKAPI_ATTR VkBool32 VKAPI_CALL DLPipeline::debugCallback(
     VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
     VkDebugUtilsMessageTypeFlagsEXT messageType,
@@ -1463,18 +1899,17 @@ void DLPipeline::recreateSwapChain()
     createImageViews();
     createColorResources();
     createDepthResources();
+    createAttachmentViews();
     createFramebuffers();
 }
 
 void DLPipeline::cleanupSwapChain()
 {
     vkDestroyImageView(device, colorImageView, nullptr);
-    vkDestroyImage(device, colorImage, nullptr);
-    vkFreeMemory(device, colorImageMemory, nullptr);
-
     vkDestroyImageView(device, depthImageView, nullptr);
-    vkDestroyImage(device, depthImage, nullptr);
-    vkFreeMemory(device, depthImageMemory, nullptr);
+
+    // the memory stays in the pool for the recreated attachments
+    attachmentPool->destroyImages();
 
     for (VkFramebuffer framebuffer : swapChainFramebuffers)
     {
@@ -1495,12 +1930,12 @@ void DLPipeline::framebufferResizeCallback(GLFWwindow* window, int width, int he
     app->framebufferResized = true;
 }
 
-VkShaderModule DLPipeline::createShaderModule(const std::vector<char>& code)
+VkShaderModule DLPipeline::createShaderModule(FileView code)
 {
     VkShaderModuleCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = code.size();
-    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    createInfo.codeSize = code.size;
+    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data);
 
     VkShaderModule shaderModule;
     if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
@@ -1511,54 +1946,50 @@ VkShaderModule DLPipeline::createShaderModule(const std::vector<char>& code)
     return shaderModule;
 }
 
-std::vector<char> DLPipeline::readFile(const std::string& filename)
+void DLPipeline::copyToImage(const unsigned char* data, VkImage image, uint32_t mipLevel, uint32_t width, uint32_t height, uint32_t rowHeight,
+    VkDeviceSize rowPitch)
 {
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
-    if (!file.is_open())
-    {
-        throw std::runtime_error("failed to open " + filename);
-    }
-
-    size_t fileSize = (size_t)file.tellg();
-    std::vector<char> buffer(fileSize);
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
-    file.close();
+    uint32_t rowCount = (height + rowHeight - 1) / rowHeight;
+    uint32_t rowsPerPiece = static_cast<uint32_t>(std::max((VkDeviceSize)1, stagingRing->getChunkSize() / rowPitch));
 
-    return buffer;
-}
+    // a mip too large for the ring goes through it a band of rows at a time
+    for (uint32_t row = 0; row < rowCount; row += rowsPerPiece)
+    {
+        uint32_t rows = std::min(rowsPerPiece, rowCount - row);
+        VkDeviceSize size = rows * rowPitch;
 
-void DLPipeline::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
-{
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+        StagingRegion staging = stagingRing->allocate(size);
+        memcpy(staging.data, data + row * rowPitch, static_cast<size_t>(size));
 
-    VkBufferImageCopy region{};
-    region.bufferOffset = 0;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
+        // allocating may have flushed the batch, so the command buffer is fetched after it
+        VkCommandBuffer commandBuffer = setupCommandBuffer();
 
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
+        VkBufferImageCopy region{};
+        region.bufferOffset = staging.offset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
 
-    region.imageOffset = { 0, 0, 0 };
-    region.imageExtent = {
-        width,
-        height,
-        1
-    };
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = mipLevel;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
 
-    vkCmdCopyBufferToImage(
-        commandBuffer,
-        buffer,
-        image,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        1,
-        &region
-    );
+        region.imageOffset = { 0, static_cast<int32_t>(row * rowHeight), 0 };
+        region.imageExtent = {
+            width,
+            std::min(rows * rowHeight, height - row * rowHeight),
+            1
+        };
 
-    endSingleTimeCommands(commandBuffer);
+        vkCmdCopyBufferToImage(
+            commandBuffer,
+            staging.buffer,
+            image,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1,
+            &region
+        );
+    }
 }
 
 void DLPipeline::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
@@ -1591,15 +2022,6 @@ void DLPipeline::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t ima
 
     vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-    // bind graphics pipeline. Second argument is for graphics or compute shader
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-
-    VkBuffer vertexBuffers[] = { vertexBuffer->buffer };
-    VkDeviceSize offsets[] = { 0 };
-    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-
-    vkCmdBindIndexBuffer(commandBuffer, indexBuffer->buffer, 0, VK_INDEX_TYPE_UINT32);
-
     VkViewport viewport{};
     viewport.x = 0.0f;
     viewport.y = 0.0f;
@@ -1614,9 +2036,60 @@ void DLPipeline::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t ima
     scissor.extent = swapChainExtent;
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 0, nullptr);
+    // every model's surviving meshlets in one block, each model draws its own range out of it.
+    // A scene with more visible meshlets than the arena has room for this frame draws them one by one instead
+    VkDeviceSize drawSize = sizeof(VkDrawIndexedIndirectCommand);
+    uint32_t drawOffset = 0;
+    bool drawIndirect = multiDrawIndirectEnabled && !meshletDraws.empty()
+        && drawSize * meshletDraws.size() <= frameArena->getAvailable();
 
-    vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+    if (drawIndirect)
+    {
+        drawOffset = frameArena->push(meshletDraws.data(), drawSize * meshletDraws.size());
+    }
+
+    VkPipeline boundPipeline = VK_NULL_HANDLE;
+
+    for (const ModelDraw& draw : modelDraws)
+    {
+        Model& model = models[draw.model];
+        const GpuMesh* mesh = resources->getMesh(model.mesh);
+
+        // bind graphics pipeline. Second argument is for graphics or compute shader
+        if (draw.pipeline != boundPipeline)
+        {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draw.pipeline);
+            boundPipeline = draw.pipeline;
+        }
+
+        // every mesh is a range of its geometry block's two buffers
+        VkBuffer vertexBuffers[] = { mesh->vertexBuffer, mesh->vertexBuffer };
+        VkDeviceSize offsets[] = { mesh->vertexOffset, mesh->colorOffset };
+        vkCmdBindVertexBuffers(commandBuffer, 0, mesh->format.hasColor ? 1 : 2, vertexBuffers, offsets);
+
+        vkCmdBindIndexBuffer(commandBuffer, mesh->indexBuffer, mesh->indexOffset, VertexPacker::getIndexType(mesh->format));
+
+        VkDescriptorSet descriptorSet = resources->getDescriptorSet(model.material, currentFrame);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 1, &draw.uniformOffset);
+
+        // one indirect call when the device can take several draws at once
+        if (drawIndirect)
+        {
+            for (uint32_t first = 0; first < draw.drawCount; first += maxDrawIndirectCount)
+            {
+                uint32_t count = std::min(maxDrawIndirectCount, draw.drawCount - first);
+                vkCmdDrawIndexedIndirect(commandBuffer, frameArena->getBuffer(), drawOffset + (draw.firstDraw + first) * drawSize, count,
+                    static_cast<uint32_t>(drawSize));
+            }
+        }
+        else
+        {
+            for (uint32_t d = draw.firstDraw; d < draw.firstDraw + draw.drawCount; d++)
+            {
+                vkCmdDrawIndexed(commandBuffer, meshletDraws[d].indexCount, 1, meshletDraws[d].firstIndex, 0, 0);
+            }
+        }
+    }
 
     vkCmdEndRenderPass(commandBuffer);
 
@@ -1629,8 +2102,6 @@ void DLPipeline::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t ima
 
 void DLPipeline::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
 {
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     barrier.oldLayout = oldLayout;
@@ -1694,6 +2165,9 @@ void DLPipeline::transitionImageLayout(VkImage image, VkFormat format, VkImageLa
 
 
 
+    // transfer stages can run on the transfer queue, shader stages need graphics
+    VkCommandBuffer commandBuffer = (destinationStage == VK_PIPELINE_STAGE_TRANSFER_BIT) ? setupCommandBuffer() : setupGraphicsCommandBuffer();
+
     vkCmdPipelineBarrier(
         commandBuffer,
         sourceStage, destinationStage,
@@ -1702,13 +2176,6 @@ void DLPipeline::transitionImageLayout(VkImage image, VkFormat format, VkImageLa
         0, nullptr,
         1, &barrier
     );
-
-    endSingleTimeCommands(commandBuffer);
-}
-
-void DLPipeline::createTextureImageView()
-{
-    textureImageView = createImageView(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
 }
 
 void DLPipeline::createTextureSampler()
@@ -1734,7 +2201,7 @@ void DLPipeline::createTextureSampler()
     samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     samplerInfo.mipLodBias = 0.0f;
     samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = static_cast<float>(mipLevels);
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE; // shared by every texture, whatever its mip count
 
     if (vkCreateSampler(device, &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS)
     {
@@ -1755,7 +2222,7 @@ void DLPipeline::generateMipmaps(VkImage image, VkFormat imageFormat, int32_t te
         throw std::runtime_error("texture image format does not support linear blitting!");
     }
 
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+    VkCommandBuffer commandBuffer = setupGraphicsCommandBuffer();
 
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -1831,53 +2298,6 @@ void DLPipeline::generateMipmaps(VkImage image, VkFormat imageFormat, int32_t te
         0, nullptr,
         0, nullptr,
         1, &barrier);
-
-    endSingleTimeCommands(commandBuffer);
-
-}
-
-void DLPipeline::loadModel()
-{
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string warn, err;
-
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, MODEL_PATH.c_str()))
-    {
-        throw std::runtime_error(warn + err);
-    }
-
-    std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-
-    for (const tinyobj::shape_t shape : shapes)
-    {
-        for (const tinyobj::index_t index : shape.mesh.indices)
-        {
-            Vertex vertex{};
-
-            vertex.pos = {
-                attrib.vertices[3 * index.vertex_index + 0],
-                attrib.vertices[3 * index.vertex_index + 1],
-                attrib.vertices[3 * index.vertex_index + 2]
-            };
-
-            vertex.texCoord = {
-                attrib.texcoords[2 * index.texcoord_index + 0],
-                -1.0f * attrib.texcoords[2 * index.texcoord_index + 1]
-            };
-
-            vertex.color = { 1.0f, 1.0f, 1.0f };
-
-            if (uniqueVertices.count(vertex) == 0)
-            {
-                uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-                vertices.push_back(vertex);
-            }
-
-            indices.push_back(uniqueVertices[vertex]);
-        }
-    }
 }
 
 VkSampleCountFlagBits DLPipeline::getMaxUsableSampleCount()
@@ -1904,8 +2324,15 @@ void DLPipeline::createColorResources()
 {
     VkFormat colorFormat = swapChainImageFormat;
 
-    createImage(swapChainExtent.width, swapChainExtent.height, 1,
-        msaaSamples, colorFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT |
-        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, colorImage, colorImageMemory);
-    colorImageView = createImageView(colorImage, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+    colorImage = attachmentPool->createImage(swapChainExtent.width, swapChainExtent.height, msaaSamples, colorFormat,
+        VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
+}
+
+void DLPipeline::createAttachmentViews()
+{
+    // views need memory, so the attachments all get bound in one go first
+    attachmentPool->bindImages();
+
+    colorImageView = createImageView(colorImage, swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+    depthImageView = createImageView(depthImage, findDepthFormat(), VK_IMAGE_ASPECT_DEPTH_BIT, 1);
 }
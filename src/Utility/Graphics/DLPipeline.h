@@ -19,21 +19,42 @@
 #include <limits>
 #include <chrono>
 #include <unordered_map>
+#include <filesystem>
 
 #include "../Math/Vector2.h"
 #include "../Math/Vector3.h"
 #include "../Math/Matrix4.h"
 #include "../Math/Pi.h"
+#include "../ThreadPool.h"
+#include "../JobGraph.h"
+#include "../FileWatcher.h"
+#include "../VirtualFileSystem.h"
 #include "Vertex.h"
+#include "DeviceAllocator.h"
 #include "MemoryPool.h"
+#include "StagingRing.h"
+#include "UploadContext.h"
+#include "AttachmentPool.h"
+#include "FrameArena.h"
+#include "TextureLoader.h"
+#include "PipelineCache.h"
+#include "PipelineRegistry.h"
+#include "ShaderCompiler.h"
+#include "MeshCache.h"
+#include "ObjImporter.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
+#include "ClusterCuller.h"
+#include "VertexPacker.h"
+#include "ResourceManager.h"
+#include "Model.h"
 
 #include <ctime>
 #include <cstring>
 
 #include <stb_image.h>
 
-#include <tiny_obj_loader.h>
-
 struct SwapChainSupportDetails;
 
 struct UniformBufferObject;
@@ -75,11 +96,38 @@ public:
     // devices and physical devices
     VkPhysicalDevice physicalDevice;
     VkDevice device; //UPGRADEME should have a getter
+    DeviceAllocator* allocator;
+    StagingRing* stagingRing;
+    UploadContext* uploadContext;
+    VirtualFileSystem* vfs;
+    ThreadPool* threadPool;
+    TextureLoader* textureLoader;
+    ResourceManager* resources;
+    bool memoryBudgetEnabled = false; // VK_EXT_memory_budget
+    bool textureCompressionEnabled = false; // textureCompressionBC, baked textures fall back to rgba8 without it
+    bool multiDrawIndirectEnabled = false; // without it the culled meshlets are drawn one vkCmdDrawIndexed each
+    uint32_t maxDrawIndirectCount = 1;
 
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+    // safe from any thread once the render pass and pipeline layout exist, PipelineRegistry calls it from the pool
+    VkPipeline createGraphicsPipeline(const PipelineState& state);
     VkCommandBuffer beginSingleTimeCommands();
     void endSingleTimeCommands(VkCommandBuffer commandBuffer);
 
+    // records into the shared setup command buffer, nothing runs until flushSetupCommands
+    VkCommandBuffer setupCommandBuffer();
+    VkCommandBuffer setupGraphicsCommandBuffer();
+    VkFence flushSetupCommands();
+
+    // records the copy and mip generation of rgba8 pixels into a new sampled image, leaves it in shader read layout
+    void uploadTexture(const void* pixels, uint32_t width, uint32_t height, uint32_t mipLevels, VkImage& image, DeviceAllocation& imageAllocation);
+    // same for a baked texture, every mip comes from the file so there are only copies and no blits
+    void uploadBakedTexture(const BakedTexture& texture, VkImage& image, DeviceAllocation& imageAllocation);
+    VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
+
+    // loads (or shares) the mesh and texture and puts an object using them into the scene
+    ModelHandle addModel(const std::string& meshPath, const std::string& texturePath, const Matrix4& transform);
+    void removeModel(ModelHandle handle);
 
 private:
 
@@ -93,6 +141,8 @@ private:
     
     VkQueue graphicsQueue;
     VkQueue presentQueue;
+    VkQueue transferQueue; // same as graphicsQueue when there is no usable transfer family
+    bool asyncTransfer = false;
 
     // swap chain member variables
     VkSwapchainKHR swapChain;
@@ -105,7 +155,10 @@ private:
     VkRenderPass renderPass;
     VkDescriptorSetLayout descriptorSetLayout;
     VkPipelineLayout pipelineLayout;
-    VkPipeline graphicsPipeline;
+    PipelineRegistry* pipelines;
+    ShaderCompiler* shaderCompiler;
+    std::vector<std::pair<VertexFormat, PipelineId>> formatPipelines; // the pipeline each vertex layout the scene's meshes use is drawn with
+    PipelineCache* pipelineCache; // every pipeline is created with it
 
     // frame buffers
     std::vector<VkFramebuffer> swapChainFramebuffers;
@@ -121,41 +174,35 @@ private:
     std::vector<VkSemaphore> renderFinishedSemaphores;
     std::vector<VkFence> inFlightFences;
 
-    // shader buffers
-    MPBuffer* vertexBuffer;
-    MPBuffer* indexBuffer;
-    MemoryPool* vertexAndIndexBufferMemory;
-
-    std::vector<MPBuffer*> uniformBuffers;
-    std::vector<void*> uniformBuffersMapped;
-    MemoryPool* uniformBufferMemoryPool;
-
-    VkDescriptorPool descriptorPool;
-    std::vector<VkDescriptorSet> descriptorSets;
+    // per frame uniform data, bound with a dynamic offset
+    FrameArena* frameArena;
 
     // Images
-    uint32_t mipLevels;
-    VkImage textureImage;
-    MemoryPool* textureImageMemory;
-    VkImageView textureImageView;
     VkSampler textureSampler;
 
     VkImage depthImage;
-    VkDeviceMemory depthImageMemory;
     VkImageView depthImageView;
 
     // Models and Textures
-    std::vector<Vertex> vertices;
-    std::vector<uint32_t> indices;
+    SlotMap<Model> models;
+    std::vector<ModelDraw> modelDraws; // this frame's, one per model with meshlets left after culling
+    std::vector<VkDrawIndexedIndirectCommand> meshletDraws; // what's left of every model's lod after culling this frame
+    ClusterCullStats meshletStats{};
 
     //NEXT make some vertexes and indices for text and such
 
+    // watches the shader directory and every directory a model was loaded from, debug builds only
+    FileWatcher fileWatcher;
+    double lastHotReload = 0.0;
+
     // Multisampling
     VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
     VkImage colorImage;
-    VkDeviceMemory colorImageMemory;
     VkImageView colorImageView;
 
+    // memory behind colorImage and depthImage, kept across swap chain recreation
+    AttachmentPool* attachmentPool;
+
     long frames_per_second;
 
     // General Init and main loops
@@ -171,6 +218,12 @@ private:
 
     void updateUniformBuffer(uint32_t currentImage);
 
+    // hands changed assets to the resource manager and rebuilds the pipelines when a shader changed
+    void hotReload();
+
+    // coarsest lod whose error covers at most LOD_PIXEL_ERROR pixels
+    uint32_t selectMeshLod(const GpuMesh& mesh, const Matrix4& model, const Matrix4& view, const Matrix4& proj);
+
     // Create Functions
 
     void createInstance();
@@ -183,26 +236,36 @@ private:
 
     void createLogicalDevice();
 
+    void createVirtualFileSystem();
+
+    void createThreadPool();
+
+    void createAllocator();
+
+    void createStagingRing();
+    void createUploadContext();
+    void createAttachmentPool();
+
     void createSwapChain();
 
     void createImageViews();
 
-    VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
-
     void createRenderPass();
 
-    void createDescriptorPool();
-
-    void createDescriptorSets();
+    void createPipelineLayout();
+    void createPipelineCache();
 
-    void createGraphicsPipeline();
+    void createShaderCompiler();
+    void createPipelineRegistry();
+    // what a mesh with format is drawn with
+    PipelineState getPipelineState(const VertexFormat& format);
+    // requested the first time a mesh with this layout shows up
+    PipelineId getGraphicsPipeline(const VertexFormat& format);
 
     void createFramebuffers();
 
     void createCommandPool();
 
-    void createVertexAndIndexBuffers();
-
     void createUniformBuffers();
 
     void createCommandBuffers();
@@ -211,12 +274,19 @@ private:
     
     void createDescriptorSetLayout();
 
-    void createTextureImage();
+    void createTextureLoader();
+
+    void createResourceManager();
+
+    void createFileWatcher();
+
+    void createScene();
 
     void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling,
-        VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
+        VkImageUsageFlags usage, MemoryUsage memoryUsage, VkImage& image, DeviceAllocation& imageAllocation);
     
     void createDepthResources();
+    void createAttachmentViews();
 
     // Validation, Extensions, and Support Verification Util
 
@@ -225,6 +295,7 @@ private:
     SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
     bool checkDeviceExtensionSupport(VkPhysicalDevice physicalDevice);
+    bool isDeviceExtensionAvailable(VkPhysicalDevice physicalDevice, const char* extensionName);
 
     void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
 
@@ -233,6 +304,7 @@ private:
     int ratePhysicalDevice(VkPhysicalDevice physicalDevice);
 
     QueueFamilyIndices findQueueFamilies(VkPhysicalDevice physicalDevice);
+    bool checkTimelineSemaphoreSupport(VkPhysicalDevice physicalDevice);
 
     static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
         VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
@@ -263,13 +335,14 @@ private:
 
     // Shader Util
 
-    VkShaderModule createShaderModule(const std::vector<char>& code);
+    VkShaderModule createShaderModule(FileView code);
 
-    static std::vector<char> readFile(const std::string& filename);
 
     // Command Buffer Util
 
-    void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+    // stages one mip and copies it in, split into bands of rows (rowHeight texel rows, rowPitch bytes each) that fit the staging ring
+    void copyToImage(const unsigned char* data, VkImage image, uint32_t mipLevel, uint32_t width, uint32_t height, uint32_t rowHeight,
+        VkDeviceSize rowPitch);
 
     void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
     
@@ -277,16 +350,11 @@ private:
 
     void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
 
-    void createTextureImageView();
 
     void createTextureSampler();
 
     void generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
 
-    // Model Util
-    
-    void loadModel();
-
     // Multisampling
 
     VkSampleCountFlagBits getMaxUsableSampleCount();
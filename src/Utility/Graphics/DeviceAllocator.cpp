@@ -0,0 +1,526 @@
+#include "DeviceAllocator.h"
+#include "DLPipeline.h"
+
+
+DeviceAllocator::DeviceAllocator(DLPipeline* pipeline)
+{
+    this->pipeline = pipeline;
+    blocks = std::vector<MemoryBlock*>();
+    allocationCount = 0;
+
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(pipeline->physicalDevice, &deviceProperties);
+    bufferImageGranularity = deviceProperties.limits.bufferImageGranularity;
+    maxAllocationCount = deviceProperties.limits.maxMemoryAllocationCount;
+
+    vkGetPhysicalDeviceMemoryProperties(pipeline->physicalDevice, &memProperties);
+
+    for (uint32_t i = 0; i < VK_MAX_MEMORY_HEAPS; i++)
+    {
+        heapUsedBytes[i] = 0;
+        heapPeakBytes[i] = 0;
+    }
+
+    // unified when every heap is device local and some of it can be mapped
+    bool allHeapsDeviceLocal = true;
+    for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++)
+    {
+        if (!(memProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT))
+        {
+            allHeapsDeviceLocal = false;
+        }
+    }
+
+    bool mappableDeviceLocal = false;
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+    {
+        VkMemoryPropertyFlags flags = memProperties.memoryTypes[i].propertyFlags;
+        if ((flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) && (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+            && (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+        {
+            mappableDeviceLocal = true;
+        }
+    }
+
+    unifiedMemory = allHeapsDeviceLocal && mappableDeviceLocal;
+}
+
+DeviceAllocator::~DeviceAllocator()
+{
+
+}
+
+void DeviceAllocator::getUsageFlags(MemoryUsage usage, VkMemoryPropertyFlags& required, VkMemoryPropertyFlags& preferred, VkMemoryPropertyFlags& unwanted)
+{
+    required = 0;
+    preferred = 0;
+    unwanted = 0;
+
+    switch (usage)
+    {
+    case MemoryUsage::GPU_ONLY:
+        preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        // on unified memory a mappable type costs nothing and lets us write without staging
+        if (unifiedMemory)
+        {
+            preferred |= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        }
+        else
+        {
+            unwanted = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        }
+        break;
+
+    case MemoryUsage::UPLOAD:
+        required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        // keep staging out of the small BAR heap and out of cached memory, the cpu only writes it
+        unwanted = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        if (!unifiedMemory)
+        {
+            unwanted |= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        }
+        break;
+
+    case MemoryUsage::READBACK:
+        required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        break;
+
+    case MemoryUsage::CPU_TO_GPU:
+        required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        // ReBAR / UMA, the gpu reads it without going over the bus
+        preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        unwanted = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        break;
+
+    case MemoryUsage::TRANSIENT:
+        preferred = VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        unwanted = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        break;
+    }
+}
+
+uint32_t DeviceAllocator::findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags unwanted)
+{
+    uint32_t bestType = UINT32_MAX;
+    uint32_t bestCost = UINT32_MAX;
+    VkDeviceSize bestHeapSize = 0;
+
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+    {
+        VkMemoryPropertyFlags flags = memProperties.memoryTypes[i].propertyFlags;
+
+        if (!(typeBits & (1u << i)) || (flags & required) != required)
+        {
+            continue;
+        }
+
+        uint32_t cost = 0;
+        for (uint32_t bit = 0; bit < 32; bit++)
+        {
+            VkMemoryPropertyFlags mask = 1u << bit;
+            if (((preferred & mask) && !(flags & mask)) || ((unwanted & mask) && (flags & mask)))
+            {
+                cost++;
+            }
+        }
+
+        VkDeviceSize heapSize = memProperties.memoryHeaps[memProperties.memoryTypes[i].heapIndex].size;
+
+        if (cost < bestCost || (cost == bestCost && heapSize > bestHeapSize))
+        {
+            bestType = i;
+            bestCost = cost;
+            bestHeapSize = heapSize;
+        }
+    }
+
+    if (bestType == UINT32_MAX)
+    {
+        throw std::runtime_error("failed to find suitable memory type!");
+    }
+
+    return bestType;
+}
+
+uint32_t DeviceAllocator::findMemoryType(uint32_t typeBits, MemoryUsage usage)
+{
+    VkMemoryPropertyFlags required, preferred, unwanted;
+    getUsageFlags(usage, required, preferred, unwanted);
+
+    return findMemoryType(typeBits, required, preferred, unwanted);
+}
+
+VkDeviceSize DeviceAllocator::preferredBlockSize(uint32_t memoryTypeIndex)
+{
+    VkDeviceSize heapSize = memProperties.memoryHeaps[memProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+
+    // small heaps (BAR windows, some integrated parts) shouldn't be eaten by a single block
+    if (heapSize <= 1024ull * 1024 * 1024)
+    {
+        return heapSize / 8;
+    }
+
+    return DEFAULT_BLOCK_SIZE;
+}
+
+AllocationKind DeviceAllocator::blockKind(AllocationKind kind)
+{
+    // with a granularity of 1 there is no conflict, so everything can share the same blocks
+    if (bufferImageGranularity <= 1)
+    {
+        return AllocationKind::LINEAR;
+    }
+
+    return kind;
+}
+
+VkDeviceMemory DeviceAllocator::allocateMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** mappedData)
+{
+    if (allocationCount >= maxAllocationCount)
+    {
+        throw std::runtime_error("exceeded maxMemoryAllocationCount!");
+    }
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(pipeline->device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to allocate memory!");
+    }
+
+    allocationCount++;
+
+    typeStats[memoryTypeIndex].blockBytes += size;
+    typeStats[memoryTypeIndex].blockCount++;
+
+    *mappedData = nullptr;
+
+    // host visible memory stays mapped for its whole lifetime, a VkDeviceMemory can only be mapped once anyway
+    if (memProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        if (vkMapMemory(pipeline->device, memory, 0, VK_WHOLE_SIZE, 0, mappedData) != VK_SUCCESS)
+        {
+            freeMemory(memory, size, memoryTypeIndex);
+            throw std::runtime_error("failed to map memory!");
+        }
+    }
+
+    return memory;
+}
+
+void DeviceAllocator::freeMemory(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex)
+{
+    vkFreeMemory(pipeline->device, memory, nullptr); // implicitly unmaps
+    allocationCount--;
+
+    typeStats[memoryTypeIndex].blockBytes -= size;
+    typeStats[memoryTypeIndex].blockCount--;
+}
+
+void DeviceAllocator::trackAllocation(uint32_t memoryTypeIndex, VkDeviceSize size)
+{
+    MemoryStats& stats = typeStats[memoryTypeIndex];
+    stats.usedBytes += size;
+    stats.allocationCount++;
+    stats.peakUsedBytes = std::max(stats.peakUsedBytes, stats.usedBytes);
+
+    uint32_t heapIndex = memProperties.memoryTypes[memoryTypeIndex].heapIndex;
+    heapUsedBytes[heapIndex] += size;
+    heapPeakBytes[heapIndex] = std::max(heapPeakBytes[heapIndex], heapUsedBytes[heapIndex]);
+}
+
+void DeviceAllocator::trackFree(uint32_t memoryTypeIndex, VkDeviceSize size)
+{
+    typeStats[memoryTypeIndex].usedBytes -= size;
+    typeStats[memoryTypeIndex].allocationCount--;
+
+    heapUsedBytes[memProperties.memoryTypes[memoryTypeIndex].heapIndex] -= size;
+}
+
+uint32_t DeviceAllocator::createBlock(uint32_t memoryTypeIndex, AllocationKind kind, VkDeviceSize size)
+{
+    MemoryBlock* block = new MemoryBlock();
+    block->memoryTypeIndex = memoryTypeIndex;
+    block->kind = kind;
+    block->memory = allocateMemory(size, memoryTypeIndex, &block->mappedData);
+    block->heap.init(size);
+
+    for (uint32_t i = 0; i < blocks.size(); i++)
+    {
+        if (blocks[i] == nullptr)
+        {
+            blocks[i] = block;
+            return i;
+        }
+    }
+
+    blocks.push_back(block);
+    return static_cast<uint32_t>(blocks.size() - 1);
+}
+
+void DeviceAllocator::destroyBlock(uint32_t blockIndex)
+{
+    freeMemory(blocks[blockIndex]->memory, blocks[blockIndex]->heap.getSize(), blocks[blockIndex]->memoryTypeIndex);
+    delete blocks[blockIndex];
+    blocks[blockIndex] = nullptr;
+}
+
+DeviceAllocation DeviceAllocator::allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, AllocationKind kind)
+{
+    DeviceAllocation allocation;
+    allocation.memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, usage);
+    allocation.size = requirements.size;
+
+    VkDeviceSize blockSize = preferredBlockSize(allocation.memoryTypeIndex);
+
+    // big resources get their own memory instead of hogging most of a block
+    if (requirements.size > blockSize / 2)
+    {
+        allocation.memory = allocateMemory(requirements.size, allocation.memoryTypeIndex, &allocation.mappedData);
+        allocation.offset = 0;
+        allocation.blockIndex = DeviceAllocation::DEDICATED;
+        trackAllocation(allocation.memoryTypeIndex, allocation.size);
+        return allocation;
+    }
+
+    kind = blockKind(kind);
+
+    uint32_t blockIndex = DeviceAllocation::DEDICATED;
+
+    for (uint32_t i = 0; i < blocks.size(); i++)
+    {
+        if (blocks[i] == nullptr || blocks[i]->memoryTypeIndex != allocation.memoryTypeIndex || blocks[i]->kind != kind)
+        {
+            continue;
+        }
+
+        if (blocks[i]->heap.allocate(requirements.size, requirements.alignment, allocation.offset, allocation.node))
+        {
+            blockIndex = i;
+            break;
+        }
+    }
+
+    if (blockIndex == DeviceAllocation::DEDICATED)
+    {
+        blockIndex = createBlock(allocation.memoryTypeIndex, kind, blockSize);
+
+        if (!blocks[blockIndex]->heap.allocate(requirements.size, requirements.alignment, allocation.offset, allocation.node))
+        {
+            throw std::runtime_error("failed to sub-allocate from a fresh memory block!");
+        }
+    }
+
+    MemoryBlock* block = blocks[blockIndex];
+
+    allocation.memory = block->memory;
+    allocation.blockIndex = blockIndex;
+    trackAllocation(allocation.memoryTypeIndex, allocation.size);
+
+    if (block->mappedData != nullptr)
+    {
+        allocation.mappedData = (void*)((uintptr_t)block->mappedData + allocation.offset);
+    }
+
+    return allocation;
+}
+
+DeviceAllocation DeviceAllocator::allocateForBuffer(VkBuffer buffer, MemoryUsage usage)
+{
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(pipeline->device, buffer, &requirements);
+
+    DeviceAllocation allocation = allocate(requirements, usage, AllocationKind::LINEAR);
+
+    if (vkBindBufferMemory(pipeline->device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to bind buffer!");
+    }
+
+    return allocation;
+}
+
+DeviceAllocation DeviceAllocator::allocateForImage(VkImage image, VkImageTiling tiling, MemoryUsage usage)
+{
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(pipeline->device, image, &requirements);
+
+    AllocationKind kind = (tiling == VK_IMAGE_TILING_OPTIMAL) ? AllocationKind::OPTIMAL : AllocationKind::LINEAR;
+    DeviceAllocation allocation = allocate(requirements, usage, kind);
+
+    if (vkBindImageMemory(pipeline->device, image, allocation.memory, allocation.offset) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to bind image memory!");
+    }
+
+    return allocation;
+}
+
+void DeviceAllocator::free(DeviceAllocation& allocation)
+{
+    if (!allocation.isValid())
+    {
+        return;
+    }
+
+    trackFree(allocation.memoryTypeIndex, allocation.size);
+
+    if (allocation.blockIndex == DeviceAllocation::DEDICATED)
+    {
+        freeMemory(allocation.memory, allocation.size, allocation.memoryTypeIndex);
+        allocation = DeviceAllocation();
+        return;
+    }
+
+    MemoryBlock* block = blocks[allocation.blockIndex];
+    block->heap.free(allocation.node);
+
+    // keep one empty block around per memory type so alloc/free churn doesn't hit vkAllocateMemory every time
+    if (block->heap.isEmpty())
+    {
+        for (uint32_t i = 0; i < blocks.size(); i++)
+        {
+            if (i != allocation.blockIndex && blocks[i] != nullptr && blocks[i]->memoryTypeIndex == block->memoryTypeIndex
+                && blocks[i]->kind == block->kind && blocks[i]->heap.isEmpty())
+            {
+                destroyBlock(allocation.blockIndex);
+                break;
+            }
+        }
+    }
+
+    allocation = DeviceAllocation();
+}
+
+void DeviceAllocator::destroyAllocator()
+{
+    // anything still alive here never got freed
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+    {
+        if (typeStats[i].allocationCount != 0)
+        {
+            std::cerr << "device allocator: " << typeStats[i].allocationCount << " allocations (" << typeStats[i].usedBytes
+                << " bytes) leaked in memory type " << i << std::endl;
+        }
+    }
+
+    for (uint32_t i = 0; i < blocks.size(); i++)
+    {
+        if (blocks[i] != nullptr)
+        {
+            destroyBlock(i);
+        }
+    }
+
+    blocks.clear();
+}
+
+MemoryStats DeviceAllocator::getTypeStats(uint32_t memoryTypeIndex)
+{
+    MemoryStats stats = typeStats[memoryTypeIndex];
+
+    for (uint32_t i = 0; i < blocks.size(); i++)
+    {
+        if (blocks[i] != nullptr && blocks[i]->memoryTypeIndex == memoryTypeIndex)
+        {
+            stats.largestFreeRange = std::max(stats.largestFreeRange, blocks[i]->heap.getLargestFreeRange());
+        }
+    }
+
+    return stats;
+}
+
+MemoryStats DeviceAllocator::getHeapStats(uint32_t heapIndex)
+{
+    MemoryStats stats;
+
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+    {
+        if (memProperties.memoryTypes[i].heapIndex != heapIndex)
+        {
+            continue;
+        }
+
+        MemoryStats type = getTypeStats(i);
+        stats.blockBytes += type.blockBytes;
+        stats.usedBytes += type.usedBytes;
+        stats.blockCount += type.blockCount;
+        stats.allocationCount += type.allocationCount;
+        stats.largestFreeRange = std::max(stats.largestFreeRange, type.largestFreeRange);
+    }
+
+    // per type peaks don't add up to the heap peak, that one is tracked on its own
+    stats.peakUsedBytes = heapPeakBytes[heapIndex];
+
+    return stats;
+}
+
+MemoryBudget DeviceAllocator::getHeapBudget(uint32_t heapIndex)
+{
+    MemoryBudget budget{};
+
+    if (pipeline->memoryBudgetEnabled)
+    {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+        budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+        VkPhysicalDeviceMemoryProperties2 properties{};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        properties.pNext = &budgetProperties;
+
+        vkGetPhysicalDeviceMemoryProperties2(pipeline->physicalDevice, &properties);
+
+        budget.budget = budgetProperties.heapBudget[heapIndex];
+        budget.usage = budgetProperties.heapUsage[heapIndex];
+        budget.fromDriver = true;
+        return budget;
+    }
+
+    // without the extension assume 80% of the heap is ours and only count what we allocated
+    budget.budget = memProperties.memoryHeaps[heapIndex].size * 8 / 10;
+    budget.usage = getHeapStats(heapIndex).blockBytes;
+    budget.fromDriver = false;
+    return budget;
+}
+
+void DeviceAllocator::printStats(std::ostream& out)
+{
+    const double MB = 1024.0 * 1024.0;
+
+    out << "---- device memory ----" << std::endl;
+
+    for (uint32_t heap = 0; heap < memProperties.memoryHeapCount; heap++)
+    {
+        MemoryStats stats = getHeapStats(heap);
+        MemoryBudget budget = getHeapBudget(heap);
+
+        out << "heap " << heap << ((memProperties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device local)" : "")
+            << ": used " << stats.usedBytes / MB << " MB in " << stats.allocationCount << " allocations, "
+            << stats.blockBytes / MB << " MB reserved in " << stats.blockCount << " blocks, peak " << stats.peakUsedBytes / MB << " MB, "
+            << "budget " << budget.usage / MB << "/" << budget.budget / MB << " MB" << (budget.fromDriver ? "" : " (estimated)") << std::endl;
+
+        for (uint32_t type = 0; type < memProperties.memoryTypeCount; type++)
+        {
+            if (memProperties.memoryTypes[type].heapIndex != heap)
+            {
+                continue;
+            }
+
+            MemoryStats typeUsage = getTypeStats(type);
+            if (typeUsage.blockCount == 0)
+            {
+                continue;
+            }
+
+            out << "    type " << type << " flags " << memProperties.memoryTypes[type].propertyFlags
+                << ": used " << typeUsage.usedBytes / MB << " MB in " << typeUsage.allocationCount << " allocations, "
+                << typeUsage.blockBytes / MB << " MB reserved, peak " << typeUsage.peakUsedBytes / MB << " MB, "
+                << "fragmentation " << typeUsage.getFragmentation() * 100.0f << "%" << std::endl;
+        }
+    }
+}
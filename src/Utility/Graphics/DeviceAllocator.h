@@ -0,0 +1,159 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdlib>
+#include <vector>
+#include <stdexcept>
+#include <iostream>
+
+#include "TLSFHeap.h"
+
+class DLPipeline;
+
+// what a resource is used for, the memory type is picked from this instead of raw property flags
+enum class MemoryUsage {
+	GPU_ONLY, // only the gpu touches it after the initial upload
+	UPLOAD, // staging, written once by the cpu and copied from
+	READBACK, // written by the gpu, read back on the cpu
+	CPU_TO_GPU, // rewritten by the cpu all the time (uniforms), read by the gpu straight from there
+	TRANSIENT // render targets that never leave the tile, lazily allocated where the device has it
+};
+
+// buffers and linear images can't share a bufferImageGranularity page with optimal images
+enum class AllocationKind {
+	LINEAR,
+	OPTIMAL
+};
+
+struct DeviceAllocation {
+	VkDeviceMemory memory;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	uint32_t memoryTypeIndex;
+	uint32_t blockIndex;
+	uint32_t node;
+	void* mappedData; // null unless the memory type is host visible
+
+	static const uint32_t DEDICATED = UINT32_MAX;
+
+	DeviceAllocation()
+	{
+		memory = VK_NULL_HANDLE;
+		offset = 0;
+		size = 0;
+		memoryTypeIndex = 0;
+		blockIndex = DEDICATED;
+		node = TLSFHeap::INVALID_NODE;
+		mappedData = nullptr;
+	}
+
+	bool isValid() const { return memory != VK_NULL_HANDLE; }
+};
+
+// usage of one memory type or heap, all sizes in bytes
+struct MemoryStats {
+	VkDeviceSize blockBytes; // reserved from the driver with vkAllocateMemory, blocks and dedicated allocations
+	VkDeviceSize usedBytes; // handed out to resources
+	VkDeviceSize peakUsedBytes;
+	VkDeviceSize largestFreeRange; // biggest hole left inside the blocks
+	uint32_t blockCount;
+	uint32_t allocationCount;
+
+	MemoryStats()
+	{
+		blockBytes = 0;
+		usedBytes = 0;
+		peakUsedBytes = 0;
+		largestFreeRange = 0;
+		blockCount = 0;
+		allocationCount = 0;
+	}
+
+	// 0 when the free space in the blocks is one range, towards 1 the more it's chopped up
+	float getFragmentation() const
+	{
+		VkDeviceSize freeBytes = blockBytes - usedBytes;
+		if (freeBytes == 0)
+		{
+			return 0.0f;
+		}
+		return 1.0f - (float)largestFreeRange / (float)freeBytes;
+	}
+};
+
+// what the driver says about a heap, from VK_EXT_memory_budget when we have it
+struct MemoryBudget {
+	VkDeviceSize budget; // how much the process can use before things start getting evicted or failing
+	VkDeviceSize usage; // what the whole process uses, other apis and drivers internals included
+	bool fromDriver; // false means a guess based on the heap size and our own blocks
+};
+
+// Hands out sub-ranges of large per-memory-type VkDeviceMemory blocks so we stay far away from maxMemoryAllocationCount.
+class DeviceAllocator {
+
+private:
+	struct MemoryBlock {
+		VkDeviceMemory memory;
+		uint32_t memoryTypeIndex;
+		AllocationKind kind;
+		void* mappedData;
+		TLSFHeap heap;
+	};
+
+	DLPipeline* pipeline;
+
+	VkPhysicalDeviceMemoryProperties memProperties;
+	VkDeviceSize bufferImageGranularity;
+	uint32_t maxAllocationCount;
+	uint32_t allocationCount; // live vkAllocateMemory calls, not sub-allocations
+	bool unifiedMemory;
+
+	std::vector<MemoryBlock*> blocks;
+
+	MemoryStats typeStats[VK_MAX_MEMORY_TYPES];
+	VkDeviceSize heapUsedBytes[VK_MAX_MEMORY_HEAPS];
+	VkDeviceSize heapPeakBytes[VK_MAX_MEMORY_HEAPS];
+
+	void trackAllocation(uint32_t memoryTypeIndex, VkDeviceSize size);
+	void trackFree(uint32_t memoryTypeIndex, VkDeviceSize size);
+
+	void getUsageFlags(MemoryUsage usage, VkMemoryPropertyFlags& required, VkMemoryPropertyFlags& preferred, VkMemoryPropertyFlags& unwanted);
+
+	VkDeviceSize preferredBlockSize(uint32_t memoryTypeIndex);
+	AllocationKind blockKind(AllocationKind kind);
+
+	VkDeviceMemory allocateMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** mappedData);
+	void freeMemory(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex);
+
+	uint32_t createBlock(uint32_t memoryTypeIndex, AllocationKind kind, VkDeviceSize size);
+	void destroyBlock(uint32_t blockIndex);
+
+public:
+	// blocks default to this size unless the heap is small
+	static const VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+	DeviceAllocator(DLPipeline* pipeline);
+	~DeviceAllocator();
+
+	// cheapest type with all the required flags, missing preferred or present unwanted flags cost one each. Ties go to the bigger heap
+	uint32_t findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred = 0, VkMemoryPropertyFlags unwanted = 0);
+	uint32_t findMemoryType(uint32_t typeBits, MemoryUsage usage);
+
+	// integrated gpus and software rasterizers, device local memory is host visible so uploads don't need staging
+	bool isUnifiedMemory() { return unifiedMemory; }
+
+	DeviceAllocation allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, AllocationKind kind);
+	DeviceAllocation allocateForBuffer(VkBuffer buffer, MemoryUsage usage);
+	DeviceAllocation allocateForImage(VkImage image, VkImageTiling tiling, MemoryUsage usage);
+
+	void free(DeviceAllocation& allocation);
+	void destroyAllocator();
+
+	const VkPhysicalDeviceMemoryProperties& getMemoryProperties() { return memProperties; }
+	MemoryStats getTypeStats(uint32_t memoryTypeIndex);
+	MemoryStats getHeapStats(uint32_t heapIndex);
+	MemoryBudget getHeapBudget(uint32_t heapIndex);
+	void printStats(std::ostream& out);
+};
@@ -0,0 +1,95 @@
+#include "FrameArena.h"
+#include "DLPipeline.h"
+
+
+FrameArena::FrameArena(DLPipeline* pipeline, VkDeviceSize frameCapacity, uint32_t frameCount)
+{
+    this->pipeline = pipeline;
+    this->frameCount = frameCount;
+    frame = 0;
+    head = 0;
+
+    // every offset handed out has to work as a dynamic offset for both uniform and storage descriptors
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(pipeline->physicalDevice, &properties);
+
+    alignment = std::max(properties.limits.minUniformBufferOffsetAlignment, properties.limits.minStorageBufferOffsetAlignment);
+    alignment = std::max(alignment, (VkDeviceSize)16);
+
+    this->frameCapacity = ((frameCapacity + alignment - 1) / alignment) * alignment;
+
+    // dynamic offsets are 32 bit
+    if (this->frameCapacity * frameCount > UINT32_MAX)
+    {
+        throw std::runtime_error("frame arena is too large for dynamic offsets!");
+    }
+
+    arenaPool = new MemoryPool(pipeline);
+
+    arenaBuffer = arenaPool->createBuffer(this->frameCapacity * frameCount,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+    arenaPool->solidifyMemoryPool(MemoryUsage::CPU_TO_GPU);
+
+    if (arenaPool->getBuffer(arenaBuffer)->allocation.mappedData == nullptr)
+    {
+        throw std::runtime_error("frame arena must be host visible!");
+    }
+}
+
+FrameArena::~FrameArena()
+{
+
+}
+
+void FrameArena::beginFrame(uint32_t frame)
+{
+    this->frame = frame % frameCount;
+    head = 0;
+}
+
+FrameAllocation FrameArena::allocate(VkDeviceSize size)
+{
+    VkDeviceSize start = ((head + alignment - 1) / alignment) * alignment;
+
+    if (start + size > frameCapacity)
+    {
+        throw std::runtime_error("frame arena is out of space!");
+    }
+
+    head = start + size;
+
+    VkDeviceSize offset = frame * frameCapacity + start;
+
+    FrameAllocation allocation{};
+    allocation.data = (void*)((uintptr_t)arenaPool->getBuffer(arenaBuffer)->allocation.mappedData + offset);
+    allocation.offset = (uint32_t)offset;
+    allocation.size = size;
+
+    return allocation;
+}
+
+VkDeviceSize FrameArena::getAvailable()
+{
+    VkDeviceSize start = ((head + alignment - 1) / alignment) * alignment;
+
+    return start < frameCapacity ? frameCapacity - start : 0;
+}
+
+uint32_t FrameArena::push(const void* data, VkDeviceSize size)
+{
+    FrameAllocation allocation = allocate(size);
+    memcpy(allocation.data, data, size);
+
+    return allocation.offset;
+}
+
+VkBuffer FrameArena::getBuffer()
+{
+    return arenaPool->getBuffer(arenaBuffer)->buffer;
+}
+
+void FrameArena::destroyFrameArena()
+{
+    arenaPool->destroyMemoryPool();
+    delete arenaPool;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdlib>
+#include <vector>
+#include <stdexcept>
+
+#include "MemoryPool.h"
+
+class DLPipeline;
+
+// a slice of the arena, write it through data and bind it with offset as the dynamic descriptor offset
+struct FrameAllocation {
+	void* data;
+	uint32_t offset;
+	VkDeviceSize size;
+};
+
+// One persistently mapped buffer split into a region per frame in flight. Per object data for a frame is bumped out of that
+// frame's region and read through dynamic uniform / storage buffer offsets (or as indirect draw commands), so nothing gets
+// allocated or written to a descriptor set per object. A region is reset as a whole once the fence of the frame that last used it has signaled.
+class FrameArena {
+
+private:
+	DLPipeline* pipeline;
+
+	MemoryPool* arenaPool;
+	MPHandle arenaBuffer;
+
+	VkDeviceSize frameCapacity;
+	uint32_t frameCount;
+	VkDeviceSize alignment;
+
+	uint32_t frame;
+	VkDeviceSize head; // relative to the start of the current frame's region
+
+public:
+	FrameArena(DLPipeline* pipeline, VkDeviceSize frameCapacity, uint32_t frameCount);
+	~FrameArena();
+
+	// only once the fence of the last submission that used this frame's region has signaled
+	void beginFrame(uint32_t frame);
+
+	FrameAllocation allocate(VkDeviceSize size);
+	// copies data into a new allocation and returns its dynamic offset
+	uint32_t push(const void* data, VkDeviceSize size);
+
+	VkBuffer getBuffer();
+	VkDeviceSize getFrameCapacity() { return frameCapacity; }
+	VkDeviceSize getUsed() { return head; }
+	// the largest allocation that still fits in this frame's region
+	VkDeviceSize getAvailable();
+
+	void destroyFrameArena();
+};
@@ -2,7 +2,7 @@
 #include "DLPipeline.h"
 
 
-void MPBuffer::createNewBuffer(DLPipeline* pipeline, VkDeviceSize size, VkBufferUsageFlags usage, VkBufferUsageFlags gpuUsage)
+void MPBuffer::createNewBuffer(DLPipeline* pipeline, VkDeviceSize size, VkBufferUsageFlags usage)
 {
     
 
@@ -14,7 +14,6 @@ void MPBuffer::createNewBuffer(DLPipeline* pipeline, VkDeviceSize size, VkBuffer
     this->device = pipeline->device;
     this->size = size;
     this->usage = usage;
-    this->gpuUsage = gpuUsage;
 
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -30,27 +29,16 @@ void MPBuffer::createNewBuffer(DLPipeline* pipeline, VkDeviceSize size, VkBuffer
 }
 
 
-VkDeviceSize MemoryPool::roundTo(VkDeviceSize size, VkDeviceSize multiple)
-{
-    VkDeviceSize retSize = size;
-
-    if (retSize % multiple != 0)
-    {
-
-        retSize = ((retSize / multiple) + 1) * multiple;
-    }
-    return retSize;
-}
-
-MemoryPool::MemoryPool(DLPipeline* pipeline)
+MemoryPool::MemoryPool(DLPipeline* pipeline, bool packed)
 {
     this->pipeline = pipeline;
-	bufferList = std::vector<MPBuffer*>();
+    buffers = SlotMap<MPBuffer>();
     solid = false;
     mapped = false;
-    memRequirements = 0;
-    sizeRequirement = 0;
-    vkGetPhysicalDeviceProperties(pipeline->physicalDevice, &deviceLimits);
+    memUsage = MemoryUsage::GPU_ONLY;
+    this->packed = packed;
+    backingBuffer = VK_NULL_HANDLE;
+    backingAllocation = DeviceAllocation();
 }
 
 MemoryPool::~MemoryPool()
@@ -58,196 +46,222 @@ MemoryPool::~MemoryPool()
 
 }
 
-void MemoryPool::addBuffer(MPBuffer* buffer)
+void MemoryPool::allocateBuffer(MPBuffer* buffer)
 {
-    if (solid)
-        throw std::runtime_error("Cannot add buffer to solid memory pool!");
+    buffer->allocation = pipeline->allocator->allocateForBuffer(buffer->buffer, memUsage);
+}
 
+VkDeviceSize MemoryPool::offsetAlignment(VkBufferUsageFlags usage)
+{
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(pipeline->physicalDevice, &deviceProperties);
 
-    VkMemoryRequirements requirements;
-    vkGetBufferMemoryRequirements(pipeline->device, buffer->buffer, &requirements);
+    VkDeviceSize alignment = 16; // covers index offsets and keeps vertex data tidy
 
-    sizeRequirement += roundTo(buffer->size, buffer->getBufferOffset());
+    if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+    {
+        alignment = std::max(alignment, deviceProperties.limits.minUniformBufferOffsetAlignment);
+    }
 
-    memRequirements |= requirements.memoryTypeBits;
+    if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+    {
+        alignment = std::max(alignment, deviceProperties.limits.minStorageBufferOffsetAlignment);
+    }
 
-    bufferList.push_back(buffer);
+    return alignment;
 }
 
-void MemoryPool::solidifyMemoryPool(VkMemoryPropertyFlags flags)
+VkDeviceSize MemoryPool::layoutBuffers(std::vector<VkDeviceSize>& offsets, VkBufferUsageFlags& usage)
 {
-    if (solid)
-        throw std::runtime_error("Already solid!");
+    offsets.resize(buffers.size());
+    usage = 0;
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = sizeRequirement;
-    allocInfo.memoryTypeIndex = pipeline->findMemoryType(memRequirements, flags);
+    VkDeviceSize size = 0;
 
-    if (vkAllocateMemory(pipeline->device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+    for (int i = 0; i < buffers.size(); i++)
     {
-        throw std::runtime_error("failed to allocate memory!");
-    }
-
-    VkDeviceSize runningSize = 0;
+        MPBuffer* buffer = &buffers[i];
 
-    for (int i = 0; i < bufferList.size(); i++)
-    {
-        VkBuffer currentBuffer = bufferList[i]->buffer;
+        VkDeviceSize alignment = offsetAlignment(buffer->usage);
 
-        if (vkBindBufferMemory(pipeline->device, currentBuffer, memory, runningSize) != VK_SUCCESS) // last arg is memory offset
+        // once packed there are no per buffer VkBuffers left to ask
+        if (!(packed && solid))
         {
-            throw std::runtime_error("failed to bind buffer!");
+            VkMemoryRequirements requirements;
+            vkGetBufferMemoryRequirements(pipeline->device, buffer->buffer, &requirements);
+            alignment = std::max(alignment, requirements.alignment);
         }
 
-        bufferList[i]->memLocation = runningSize;
+        size = ((size + alignment - 1) / alignment) * alignment;
+        offsets[i] = size;
+        size += buffer->size;
 
-
-        runningSize += roundTo(bufferList.at(i)->size, bufferList[i]->getBufferOffset());
+        usage |= buffer->usage;
     }
 
-    solid = true;
+    return size;
 }
 
-void MemoryPool::copyMemory(void* dataIn, MPBuffer* memBuffer, VkDeviceSize dataSize)
+void MemoryPool::createBackingBuffer(VkDeviceSize size, VkBufferUsageFlags usage, MemoryUsage memoryUsage)
 {
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-    void* memPtr;
-    if (vkMapMemory(pipeline->device, memory, memBuffer->memLocation, memBuffer->size, 0, &memPtr) != VK_SUCCESS)
+    if (vkCreateBuffer(pipeline->device, &bufferInfo, nullptr, &backingBuffer) != VK_SUCCESS)
     {
-        throw std::runtime_error("failed to map memory!");
+        throw std::runtime_error("failed to create buffer!");
     }
-    memcpy(memPtr, dataIn, (size_t)dataSize);
-    vkUnmapMemory(pipeline->device, memory);
+
+    backingAllocation = pipeline->allocator->allocateForBuffer(backingBuffer, memoryUsage);
 }
 
-void MemoryPool::mapMemory()
+void MemoryPool::pointAtBacking(const std::vector<VkDeviceSize>& offsets)
 {
-
-    if (vkMapMemory(pipeline->device, memory, 0, sizeRequirement, 0, &mapPointer) != VK_SUCCESS)
+    for (int i = 0; i < buffers.size(); i++)
     {
-        throw std::runtime_error("failed to map memory!");
+        // the range doesn't own any memory, only the mapping is handed down
+        buffers[i].buffer = backingBuffer;
+        buffers[i].offset = offsets[i];
+        buffers[i].allocation = DeviceAllocation();
+
+        if (backingAllocation.mappedData != nullptr)
+        {
+            buffers[i].allocation.mappedData = (void*)((uintptr_t)backingAllocation.mappedData + offsets[i]);
+        }
     }
-    mapped = true;
 }
 
-void MemoryPool::copyToMappedBuffer(MPBuffer* memBuffer, void* dataIn, VkDeviceSize dataSize)
+MPHandle MemoryPool::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage)
 {
-    if (!mapped)
+    if (solid && packed)
     {
-        throw std::runtime_error("memory must be mapped!");
+        throw std::runtime_error("packed pools can't grow after they're solid!");
     }
 
-    memcpy((void*)((uintptr_t)mapPointer + memBuffer->memLocation), dataIn, memBuffer->size);
-}
-
-void MemoryPool::convertStagedMemory(VkMemoryPropertyFlags flags)
-{
-
-    if (!solid)
-        throw std::runtime_error("Memory pool must be solid!");
-
-    //create new buffers and memory object
-    VkDeviceMemory finalMemory;
-    std::vector<MPBuffer*> finalBufferList = std::vector<MPBuffer*>();
+    MPBuffer buffer;
+    buffer.createNewBuffer(pipeline, size, usage);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = sizeRequirement;
-    allocInfo.memoryTypeIndex = pipeline->findMemoryType(memRequirements, flags);
-
-    if (vkAllocateMemory(pipeline->device, &allocInfo, nullptr, &finalMemory) != VK_SUCCESS)
+    // solid pools keep accepting buffers, they just get their memory right away
+    if (solid)
     {
-        throw std::runtime_error("failed to allocate memory!");
+        allocateBuffer(&buffer);
     }
 
-    for (int i = 0; i < bufferList.size(); i++)
-    {
-        MPBuffer* tempBuffer = new MPBuffer();
-
-        tempBuffer->createNewBuffer(pipeline, bufferList[i]->size, bufferList[i]->gpuUsage, bufferList[i]->gpuUsage);
+    return buffers.insert(buffer);
+}
 
-        finalBufferList.push_back(tempBuffer);
-    }
+void MemoryPool::solidifyMemoryPool(MemoryUsage usage)
+{
+    if (solid)
+        throw std::runtime_error("Already solid!");
 
-    // bind buffers
-    VkDeviceSize runningSize = 0;
+    memUsage = usage;
 
-    for (int i = 0; i < finalBufferList.size(); i++)
+    if (packed)
     {
+        std::vector<VkDeviceSize> offsets;
+        VkBufferUsageFlags bufferUsage = 0;
+        VkDeviceSize size = layoutBuffers(offsets, bufferUsage);
 
-        vkBindBufferMemory(pipeline->device, finalBufferList[i]->buffer, finalMemory, runningSize); // last arg is memory offset
+        createBackingBuffer(size, bufferUsage, memUsage);
 
-        finalBufferList[i]->memLocation = runningSize;
+        // the buffers made by createNewBuffer were only needed for their requirements
+        for (int i = 0; i < buffers.size(); i++)
+        {
+            buffers[i].destroyBuffer();
+        }
 
-        runningSize += roundTo(bufferList[i]->size, finalBufferList[i]->getBufferOffset());
+        pointAtBacking(offsets);
 
+        solid = true;
+        return;
     }
 
-    // copy buffers over
-    VkCommandBuffer commandBuffer = pipeline->beginSingleTimeCommands();
+    for (int i = 0; i < buffers.size(); i++)
+    {
+        allocateBuffer(&buffers[i]);
+    }
 
-    for (int i = 0; i < bufferList.size(); i++)
+    solid = true;
+}
+
+void MemoryPool::mapMemory()
+{
+    // host visible allocations are persistently mapped by the allocator, this just checks that we got them
+    for (int i = 0; i < buffers.size(); i++)
     {
-        VkBufferCopy copyRegion{};
-        copyRegion.size = bufferList[i]->size;
-        vkCmdCopyBuffer(commandBuffer, bufferList.at(i)->buffer, finalBufferList[i]->buffer, 1, &copyRegion); //unsure if you can copy multiple buffers at a time with this
+        if (buffers[i].allocation.mappedData == nullptr)
+        {
+            throw std::runtime_error("failed to map memory!");
+        }
+    }
+    mapped = true;
+}
 
-        
+void MemoryPool::copyToMappedBuffer(MPHandle handle, const void* dataIn, VkDeviceSize dataSize)
+{
+    if (!mapped)
+    {
+        throw std::runtime_error("memory must be mapped!");
     }
 
-    pipeline->endSingleTimeCommands(commandBuffer);
+    MPBuffer* memBuffer = getBuffer(handle);
 
-    for (int i = 0; i < bufferList.size(); i++)
+    if (memBuffer == nullptr)
     {
-        bufferList[i]->destroyBuffer();
-        *bufferList[i] = *finalBufferList[i];
-        delete finalBufferList[i];
+        throw std::runtime_error("stale buffer handle!");
     }
 
-    vkFreeMemory(pipeline->device, memory, nullptr);
-
-    memory = finalMemory;
+    memcpy(memBuffer->allocation.mappedData, dataIn, (size_t)dataSize);
 }
 
 void MemoryPool::destroyMemoryPool(bool destroyBuffers)
 {
-    if (destroyBuffers)
+    for (uint32_t i = 0; i < buffers.size(); i++)
     {
-        for (int i = 0; i < bufferList.size(); i++)
+        pipeline->allocator->free(buffers[i].allocation);
+
+        if (destroyBuffers && !(packed && solid))
         {
-            bufferList[i]->destroyBuffer();
-            delete bufferList[i];
+            buffers[i].destroyBuffer();
         }
     }
 
-	vkFreeMemory(pipeline->device, memory, nullptr);
+    if (backingBuffer != VK_NULL_HANDLE)
+    {
+        vkDestroyBuffer(pipeline->device, backingBuffer, nullptr);
+        pipeline->allocator->free(backingAllocation);
+        backingBuffer = VK_NULL_HANDLE;
+    }
+
+    // outstanding handles go stale
+    buffers.clear();
+    solid = false;
+    mapped = false;
 }
 
-MPBuffer* MemoryPool::getBuffer(int index)
+MPBuffer* MemoryPool::getBuffer(MPHandle handle)
 {
-    return bufferList.at(index);
+    return buffers.get(handle);
 }
 
-void MemoryPool::removeBuffer(MPBuffer* buffer, bool deleteBuffer)
+void MemoryPool::removeBuffer(MPHandle handle)
 {
-    for (int i = 0; i < bufferList.size(); i++)
+    MPBuffer* buffer = buffers.get(handle);
+
+    if (buffer == nullptr)
     {
-        if (bufferList.at(i) == buffer)
-        {
-            bufferList.erase(bufferList.begin() + i);
-            if (deleteBuffer)
-            {
-                buffer->destroyBuffer();
-                delete buffer;
-            }
-            return;
-        }
+        return;
     }
-}
 
-VkDeviceMemory& MemoryPool::getMemory()
-{
-    { return memory; }
-}
+    pipeline->allocator->free(buffer->allocation); // packed ranges own nothing, their space comes back with the pool
+    if (!(packed && solid))
+    {
+        buffer->destroyBuffer();
+    }
 
+    buffers.remove(handle);
+}
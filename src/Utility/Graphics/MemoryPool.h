@@ -7,21 +7,24 @@
 #include <vector>
 #include <stdexcept>
 
+#include "DeviceAllocator.h"
+#include "SlotMap.h"
+
 class DLPipeline;
 
 struct MPBuffer {
 	VkBuffer buffer;
+	VkDeviceSize offset; // non zero when the buffer is a range of a packed pool's backing buffer
 	VkDeviceSize size;
-	VkDeviceSize memLocation;
+	DeviceAllocation allocation;
 	VkBufferUsageFlags usage;
-	VkBufferUsageFlags gpuUsage;
 private:
 	VkDevice device;
 public:
 
 	void VKBuffer() {};
 
-	void createNewBuffer(DLPipeline* pipeline, VkDeviceSize size, VkBufferUsageFlags usage, VkBufferUsageFlags gpuUsage = 0);
+	void createNewBuffer(DLPipeline* pipeline, VkDeviceSize size, VkBufferUsageFlags usage);
 
 	VkDeviceSize getBufferOffset()
 	{
@@ -38,57 +41,64 @@ public:
 	MPBuffer()
 	{
 		buffer = nullptr;
+		offset = 0;
 		size = 0;
 		usage = 0;
-		gpuUsage = 0;
 		device = nullptr;
-		memLocation = -1;
+		allocation = DeviceAllocation();
 	}
 
 	MPBuffer(const MPBuffer& copy)
 	{
 		buffer = copy.buffer;
+		offset = copy.offset;
 		size = copy.size;
 		usage = copy.usage;
-		gpuUsage = copy.gpuUsage;
 		device = copy.device;
-		memLocation = copy.memLocation;
+		allocation = copy.allocation;
 	}
 };
 
+// refers to a buffer in a MemoryPool, stays safe to use after the buffer is removed (getBuffer returns nullptr)
+typedef SlotHandle MPHandle;
+
 class MemoryPool {
 
 private:
 	DLPipeline* pipeline;
-	VkPhysicalDeviceProperties deviceLimits;
-
-	VkDeviceMemory memory;
 
-	std::vector<MPBuffer*> bufferList;
+	// buffer records live in the pool itself, no allocation per buffer
+	SlotMap<MPBuffer> buffers;
 
-	uint32_t memRequirements;
-	VkDeviceSize sizeRequirement;
+	MemoryUsage memUsage;
 
 	bool solid;
 	bool mapped;
 
-	void* mapPointer;
+	// packed pools put all their buffers into one VkBuffer and one allocation, each MPBuffer is a range of it
+	bool packed;
+	VkBuffer backingBuffer;
+	DeviceAllocation backingAllocation;
 
-	VkDeviceSize roundTo(VkDeviceSize size, VkDeviceSize multiple);
+	void allocateBuffer(MPBuffer* buffer);
+	VkDeviceSize offsetAlignment(VkBufferUsageFlags usage);
+	VkDeviceSize layoutBuffers(std::vector<VkDeviceSize>& offsets, VkBufferUsageFlags& usage);
+	void createBackingBuffer(VkDeviceSize size, VkBufferUsageFlags usage, MemoryUsage memoryUsage);
+	void pointAtBacking(const std::vector<VkDeviceSize>& offsets);
 
 public:
-	MemoryPool(DLPipeline* pipeline);
+	MemoryPool(DLPipeline* pipeline, bool packed = false);
 	~MemoryPool();
 
-	void addBuffer(MPBuffer* buffer);
-	void copyMemory(void* data_in, MPBuffer* memBuffer, VkDeviceSize dataSize);
+	MPHandle createBuffer(VkDeviceSize size, VkBufferUsageFlags usage);
 	void mapMemory();
-	void copyToMappedBuffer(MPBuffer* memBuffer, void* dataIn, VkDeviceSize dataSize);
-	void solidifyMemoryPool(VkMemoryPropertyFlags flags);
-	void convertStagedMemory(VkMemoryPropertyFlags flags);
+	void copyToMappedBuffer(MPHandle handle, const void* dataIn, VkDeviceSize dataSize);
+	void solidifyMemoryPool(MemoryUsage usage);
 	void destroyMemoryPool(bool destroyBuffers=true);
 
-	MPBuffer* getBuffer(int index);
-	void removeBuffer(MPBuffer* buffer, bool deleteBuffer=true);
-	VkDeviceMemory& getMemory();
+	// nullptr once the buffer has been removed. Only good until the next createBuffer or removeBuffer, keep the handle
+	MPBuffer* getBuffer(MPHandle handle);
+	bool isPacked() { return packed; }
+	uint32_t getBufferCount() { return buffers.size(); }
+	void removeBuffer(MPHandle handle);
 };
\ No newline at end of file
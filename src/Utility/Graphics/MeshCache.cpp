@@ -0,0 +1,184 @@
+#include "MeshCache.h"
+
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+
+const uint32_t MESH_CACHE_VERSION = 5;
+
+// keeps the blobs aligned for the vertex and index types when they're used in place
+const uint64_t MESH_BLOB_ALIGNMENT = 16;
+
+static uint64_t alignBlob(uint64_t offset)
+{
+    return ((offset + MESH_BLOB_ALIGNMENT - 1) / MESH_BLOB_ALIGNMENT) * MESH_BLOB_ALIGNMENT;
+}
+
+// size bytes at offset are inside a file of fileSize bytes, without the sum wrapping around
+static bool blobFits(uint64_t offset, uint64_t size, uint64_t fileSize)
+{
+    return offset <= fileSize && size <= fileSize - offset;
+}
+
+std::string MeshCache::cachePath(const std::string& source)
+{
+    return source + ".dlmesh";
+}
+
+void MeshCache::write(const std::string& path, const PackedMesh& mesh)
+{
+    MeshHeader header{};
+    memcpy(header.magic, "DLMS", 4);
+    header.version = MESH_CACHE_VERSION;
+    header.format = mesh.format;
+    header.vertexCount = mesh.vertexCount;
+    header.indexCount = mesh.indexCount;
+    memcpy(header.boundsMin, mesh.boundsMin, sizeof(header.boundsMin));
+    memcpy(header.boundsMax, mesh.boundsMax, sizeof(header.boundsMax));
+    header.lodCount = mesh.lodCount;
+    memcpy(header.lods, mesh.lods, sizeof(header.lods));
+    header.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+    header.hash = mesh.hash;
+
+    header.vertexOffset = alignBlob(sizeof(MeshHeader));
+    header.indexOffset = alignBlob(header.vertexOffset + mesh.vertices.size());
+    header.meshletOffset = alignBlob(header.indexOffset + mesh.indices.size());
+
+    // written aside and moved into place, so a half written file is never mapped
+    std::string temporaryPath = path + ".tmp";
+
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+
+        if (!file.is_open())
+        {
+            throw std::runtime_error("failed to write mesh cache!");
+        }
+
+        const char padding[MESH_BLOB_ALIGNMENT] = {};
+
+        file.write((const char*)&header, sizeof(header));
+        file.write(padding, header.vertexOffset - sizeof(header));
+        file.write((const char*)mesh.vertices.data(), mesh.vertices.size());
+        file.write(padding, header.indexOffset - (header.vertexOffset + mesh.vertices.size()));
+        file.write((const char*)mesh.indices.data(), mesh.indices.size());
+        file.write(padding, header.meshletOffset - (header.indexOffset + mesh.indices.size()));
+        file.write((const char*)mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet));
+
+        if (!file)
+        {
+            throw std::runtime_error("failed to write mesh cache!");
+        }
+    }
+
+    std::filesystem::rename(temporaryPath, path);
+}
+
+bool MeshCache::view(FileView file, MeshView& mesh)
+{
+    if (!file.isValid() || file.size < sizeof(MeshHeader))
+    {
+        return false;
+    }
+
+    const unsigned char* bytes = file.data;
+    const MeshHeader* header = (const MeshHeader*)bytes;
+
+    // a cache from an older build or with a format this build can't draw is useless, it gets imported again
+    if (memcmp(header->magic, "DLMS", 4) != 0 || header->version != MESH_CACHE_VERSION || !VertexPacker::isValid(header->format))
+    {
+        return false;
+    }
+
+    if (!blobFits(header->vertexOffset, (uint64_t)header->vertexCount * header->format.stride, file.size)
+        || !blobFits(header->indexOffset, (uint64_t)header->indexCount * header->format.indexSize, file.size)
+        || !blobFits(header->meshletOffset, (uint64_t)header->meshletCount * sizeof(Meshlet), file.size)
+        || header->indexOffset % header->format.indexSize != 0 || header->meshletOffset % alignof(Meshlet) != 0)
+    {
+        return false;
+    }
+
+    if (header->lodCount == 0 || header->lodCount > MAX_MESH_LODS)
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < header->lodCount; i++)
+    {
+        if ((uint64_t)header->lods[i].firstIndex + header->lods[i].indexCount > header->indexCount
+            || (uint64_t)header->lods[i].firstMeshlet + header->lods[i].meshletCount > header->meshletCount)
+        {
+            return false;
+        }
+    }
+
+    const Meshlet* meshlets = (const Meshlet*)(bytes + header->meshletOffset);
+
+    for (uint32_t i = 0; i < header->meshletCount; i++)
+    {
+        if ((uint64_t)meshlets[i].firstIndex + meshlets[i].indexCount > header->indexCount)
+        {
+            return false;
+        }
+    }
+
+    // an index past the vertices would read outside the mesh's range of the shared vertex buffer
+    if (header->format.indexSize == sizeof(uint16_t))
+    {
+        const uint16_t* indices = (const uint16_t*)(bytes + header->indexOffset);
+
+        for (uint32_t i = 0; i < header->indexCount; i++)
+        {
+            if (indices[i] >= header->vertexCount)
+            {
+                return false;
+            }
+        }
+    }
+    else
+    {
+        const uint32_t* indices = (const uint32_t*)(bytes + header->indexOffset);
+
+        for (uint32_t i = 0; i < header->indexCount; i++)
+        {
+            if (indices[i] >= header->vertexCount)
+            {
+                return false;
+            }
+        }
+    }
+
+    mesh.format = header->format;
+    mesh.vertices = bytes + header->vertexOffset;
+    mesh.vertexCount = header->vertexCount;
+    mesh.indices = bytes + header->indexOffset;
+    mesh.indexCount = header->indexCount;
+    mesh.boundsMin = Vector3(header->boundsMin[0], header->boundsMin[1], header->boundsMin[2]);
+    mesh.boundsMax = Vector3(header->boundsMax[0], header->boundsMax[1], header->boundsMax[2]);
+    mesh.lodCount = header->lodCount;
+    memcpy(mesh.lods, header->lods, sizeof(mesh.lods));
+    mesh.meshlets = meshlets;
+    mesh.meshletCount = header->meshletCount;
+    mesh.hash = header->hash;
+
+    return true;
+}
+
+MeshView MeshCache::view(const PackedMesh& packed)
+{
+    MeshView mesh{};
+    mesh.format = packed.format;
+    mesh.vertices = packed.vertices.data();
+    mesh.vertexCount = packed.vertexCount;
+    mesh.indices = packed.indices.data();
+    mesh.indexCount = packed.indexCount;
+    mesh.boundsMin = Vector3(packed.boundsMin[0], packed.boundsMin[1], packed.boundsMin[2]);
+    mesh.boundsMax = Vector3(packed.boundsMax[0], packed.boundsMax[1], packed.boundsMax[2]);
+    mesh.lodCount = packed.lodCount;
+    memcpy(mesh.lods, packed.lods, sizeof(mesh.lods));
+    mesh.meshlets = packed.meshlets.data();
+    mesh.meshletCount = static_cast<uint32_t>(packed.meshlets.size());
+    mesh.hash = packed.hash;
+
+    return mesh;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "VertexPacker.h"
+#include "../VirtualFileSystem.h"
+
+// layout of a .dlmesh file: this header, then the vertex, index and meshlet blobs at the offsets it gives
+struct MeshHeader {
+	char magic[4];
+	uint32_t version;
+	VertexFormat format;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	float boundsMin[3];
+	float boundsMax[3];
+	uint32_t lodCount;
+	MeshLod lods[MAX_MESH_LODS];
+	uint32_t meshletCount;
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint64_t meshletOffset;
+	uint64_t hash;
+};
+
+// Mesh data wherever it lives, straight out of a mapped cache file (loose or packed) or out of a fresh import.
+// Only valid as long as the mapping / vectors it was made from.
+struct MeshView {
+	VertexFormat format;
+	const void* vertices; // format.stride bytes each
+	uint32_t vertexCount;
+	const void* indices; // format.indexSize bytes each
+	uint32_t indexCount;
+	Vector3 boundsMin;
+	Vector3 boundsMax;
+	MeshLod lods[MAX_MESH_LODS]; // lod 0 is the whole mesh
+	uint32_t lodCount;
+	const Meshlet* meshlets;
+	uint32_t meshletCount;
+	uint64_t hash; // identical geometry under another name has the same one
+};
+
+// Imported models are written out in the exact layout the vertex and index buffers use, so later launches map the file
+// and copy it into the upload pool without parsing or rebuilding anything.
+class MeshCache {
+
+public:
+	static std::string cachePath(const std::string& source);
+
+	static void write(const std::string& path, const PackedMesh& mesh);
+
+	// false if the file isn't a mesh cache this build can read, or if any index or meshlet points outside the mesh
+	static bool view(FileView file, MeshView& mesh);
+	static MeshView view(const PackedMesh& packed);
+};
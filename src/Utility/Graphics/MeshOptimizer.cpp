@@ -0,0 +1,364 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+// a cluster is cut once its own cache miss rate is this close to the whole mesh's, smaller clusters sort better for overdraw
+const float CLUSTER_ACMR_THRESHOLD = 1.05f;
+
+VertexCacheStats MeshOptimizer::analyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize)
+{
+    // time each vertex last went into the fifo, it's still in there while it's less than cacheSize misses old
+    std::vector<uint32_t> cachedAt(vertexCount, 0);
+    std::vector<bool> referenced(vertexCount, false);
+
+    uint32_t misses = 0;
+    uint32_t uniqueVertices = 0;
+
+    for (uint32_t index : indices)
+    {
+        if (!referenced[index])
+        {
+            referenced[index] = true;
+            uniqueVertices++;
+        }
+
+        if (cachedAt[index] == 0 || misses - cachedAt[index] >= cacheSize)
+        {
+            misses++;
+            cachedAt[index] = misses;
+        }
+    }
+
+    VertexCacheStats stats{};
+    stats.acmr = indices.empty() ? 0.0f : misses / (float)(indices.size() / 3);
+    stats.atvr = uniqueVertices == 0 ? 0.0f : misses / (float)uniqueVertices;
+
+    return stats;
+}
+
+std::vector<uint32_t> MeshOptimizer::optimizeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, std::vector<uint32_t>& clusters)
+{
+    uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+    // triangles around every vertex, packed
+    std::vector<uint32_t> liveTriangles(vertexCount, 0);
+    for (uint32_t index : indices)
+    {
+        liveTriangles[index]++;
+    }
+
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (uint32_t v = 0; v < vertexCount; v++)
+    {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+    }
+
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (uint32_t t = 0; t < triangleCount; t++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            uint32_t v = indices[t * 3 + c];
+            adjacency[fill[v]++] = t;
+        }
+    }
+
+    std::vector<uint32_t> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnds;
+    std::vector<uint32_t> candidates;
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+
+    uint32_t timestamp = VERTEX_CACHE_SIZE + 1;
+    uint32_t cursor = 0;
+
+    // next vertex with live triangles when the fan runs dry. Starts a new cluster, the cache is cold there anyway
+    auto skipDeadEnd = [&]() -> int64_t
+        {
+            while (!deadEnds.empty())
+            {
+                uint32_t v = deadEnds.back();
+                deadEnds.pop_back();
+                if (liveTriangles[v] > 0)
+                {
+                    return v;
+                }
+            }
+
+            while (cursor < vertexCount)
+            {
+                if (liveTriangles[cursor] > 0)
+                {
+                    return cursor;
+                }
+                cursor++;
+            }
+
+            return -1;
+        };
+
+    int64_t fan = skipDeadEnd();
+
+    while (fan >= 0)
+    {
+        candidates.clear();
+
+        for (uint32_t a = adjacencyOffsets[fan]; a < adjacencyOffsets[fan + 1]; a++)
+        {
+            uint32_t t = adjacency[a];
+            if (emitted[t])
+            {
+                continue;
+            }
+
+            for (int c = 0; c < 3; c++)
+            {
+                uint32_t v = indices[t * 3 + c];
+                result.push_back(v);
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+
+                if (timestamp - cacheTime[v] > VERTEX_CACHE_SIZE)
+                {
+                    cacheTime[v] = timestamp++;
+                }
+            }
+
+            emitted[t] = true;
+        }
+
+        // the candidate that stays in the cache longest while still having triangles to emit
+        int64_t next = -1;
+        int64_t bestPriority = -1;
+
+        for (uint32_t v : candidates)
+        {
+            if (liveTriangles[v] == 0)
+            {
+                continue;
+            }
+
+            int64_t priority = 0;
+            if (timestamp - cacheTime[v] + 2 * liveTriangles[v] <= VERTEX_CACHE_SIZE)
+            {
+                priority = timestamp - cacheTime[v];
+            }
+
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                next = v;
+            }
+        }
+
+        if (next < 0)
+        {
+            next = skipDeadEnd();
+
+            if (next >= 0)
+            {
+                clusters.push_back(static_cast<uint32_t>(result.size() / 3));
+            }
+        }
+
+        fan = next;
+    }
+
+    if (clusters.empty() || clusters.front() != 0)
+    {
+        clusters.insert(clusters.begin(), 0);
+    }
+
+    return result;
+}
+
+void MeshOptimizer::splitClusters(const std::vector<uint32_t>& indices, uint32_t vertexCount, std::vector<uint32_t>& clusters)
+{
+    // soft cuts inside the hard ones from tipsify, wherever a cluster already reuses the cache about as well as the mesh does
+    float threshold = analyzeVertexCache(indices, vertexCount).acmr * CLUSTER_ACMR_THRESHOLD;
+    uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+    std::vector<uint32_t> cachedAt(vertexCount, 0);
+    std::vector<uint32_t> split;
+
+    size_t hard = 0;
+    uint32_t misses = 0;
+    uint32_t clusterMisses = 0;
+    uint32_t clusterTriangles = 0;
+
+    for (uint32_t t = 0; t < triangleCount; t++)
+    {
+        bool hardCut = hard < clusters.size() && clusters[hard] == t;
+        if (hardCut)
+        {
+            hard++;
+        }
+
+        if (hardCut || (clusterTriangles > 0 && clusterMisses <= threshold * clusterTriangles))
+        {
+            split.push_back(t);
+            clusterMisses = 0;
+            clusterTriangles = 0;
+
+            // clusters get reordered, so each one has to be measured from a cold cache
+            misses += VERTEX_CACHE_SIZE;
+        }
+
+        for (int c = 0; c < 3; c++)
+        {
+            uint32_t v = indices[t * 3 + c];
+
+            if (cachedAt[v] == 0 || misses - cachedAt[v] >= VERTEX_CACHE_SIZE)
+            {
+                misses++;
+                clusterMisses++;
+                cachedAt[v] = misses;
+            }
+        }
+
+        clusterTriangles++;
+    }
+
+    clusters = split;
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& clusters)
+{
+    uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+    struct Cluster {
+        uint32_t start;
+        uint32_t end;
+        float sortKey;
+    };
+
+    // area weighted centroid of every cluster and of the whole mesh
+    std::vector<Cluster> sorted(clusters.size());
+    std::vector<float> centroids(clusters.size() * 3, 0.0f);
+    std::vector<float> normals(clusters.size() * 3, 0.0f);
+    std::vector<float> areas(clusters.size(), 0.0f);
+    float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+    float meshArea = 0.0f;
+
+    for (size_t c = 0; c < clusters.size(); c++)
+    {
+        sorted[c].start = clusters[c];
+        sorted[c].end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+        for (uint32_t t = sorted[c].start; t < sorted[c].end; t++)
+        {
+            const Vertex& a = vertices[indices[t * 3 + 0]];
+            const Vertex& b = vertices[indices[t * 3 + 1]];
+            const Vertex& d = vertices[indices[t * 3 + 2]];
+
+            float ab[3] = { b.pos[0] - a.pos[0], b.pos[1] - a.pos[1], b.pos[2] - a.pos[2] };
+            float ad[3] = { d.pos[0] - a.pos[0], d.pos[1] - a.pos[1], d.pos[2] - a.pos[2] };
+            float normal[3] = {
+                ab[1] * ad[2] - ab[2] * ad[1],
+                ab[2] * ad[0] - ab[0] * ad[2],
+                ab[0] * ad[1] - ab[1] * ad[0]
+            };
+
+            float area = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+            for (int i = 0; i < 3; i++)
+            {
+                float center = (a.pos[i] + b.pos[i] + d.pos[i]) / 3.0f;
+                centroids[c * 3 + i] += center * area;
+                normals[c * 3 + i] += normal[i];
+                meshCentroid[i] += center * area;
+            }
+
+            areas[c] += area;
+            meshArea += area;
+        }
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        meshCentroid[i] = meshArea > 0.0f ? meshCentroid[i] / meshArea : 0.0f;
+    }
+
+    // clusters far out and facing away from the middle are the ones most likely to cover others, draw them first
+    for (size_t c = 0; c < clusters.size(); c++)
+    {
+        float normalLength = std::sqrt(normals[c * 3] * normals[c * 3] + normals[c * 3 + 1] * normals[c * 3 + 1] + normals[c * 3 + 2] * normals[c * 3 + 2]);
+        float key = 0.0f;
+
+        if (areas[c] > 0.0f && normalLength > 0.0f)
+        {
+            for (int i = 0; i < 3; i++)
+            {
+                key += (centroids[c * 3 + i] / areas[c] - meshCentroid[i]) * (normals[c * 3 + i] / normalLength);
+            }
+        }
+
+        sorted[c].sortKey = key;
+    }
+
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+
+    for (const Cluster& cluster : sorted)
+    {
+        result.insert(result.end(), indices.begin() + cluster.start * 3, indices.begin() + cluster.end * 3);
+    }
+
+    indices = std::move(result);
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+    std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+    std::vector<Vertex> result;
+    result.reserve(vertices.size());
+
+    for (uint32_t& index : indices)
+    {
+        if (remap[index] == UINT32_MAX)
+        {
+            remap[index] = static_cast<uint32_t>(result.size());
+            result.push_back(vertices[index]);
+        }
+
+        index = remap[index];
+    }
+
+    // unreferenced vertices are dropped
+    vertices = std::move(result);
+}
+
+void MeshOptimizer::optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+    optimizeTriangles(vertices, indices);
+    optimizeVertexFetch(vertices, indices);
+}
+
+void MeshOptimizer::optimizeTriangles(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+    uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+
+    std::vector<uint32_t> clusters;
+    std::vector<uint32_t> optimized = optimizeVertexCache(indices, vertexCount, clusters);
+
+    // keep the authored order when it already beats tipsify (e.g. strip-ordered exports)
+    if (analyzeVertexCache(optimized, vertexCount, VERTEX_CACHE_SIZE).acmr <= analyzeVertexCache(indices, vertexCount, VERTEX_CACHE_SIZE).acmr)
+    {
+        indices = std::move(optimized);
+    }
+    else
+    {
+        clusters.assign(1, 0);
+    }
+
+    splitClusters(indices, vertexCount, clusters);
+    optimizeOverdraw(indices, vertices, clusters);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Vertex.h"
+
+// post transform cache size the orderings are tuned for and measured with
+const uint32_t VERTEX_CACHE_SIZE = 16;
+
+struct VertexCacheStats {
+	float acmr; // cache misses per triangle, 0.5 is the ideal for a big regular mesh, 3 is the worst
+	float atvr; // cache misses per referenced vertex, 1 is ideal
+};
+
+// Reorders an imported triangle list for the gpu, without changing what's drawn:
+// triangles for post transform cache reuse (tipsify), clusters of them so outward facing ones come first and occlude
+// the rest (less overdraw), then vertices into first use order so fetching them walks memory forwards.
+class MeshOptimizer {
+
+private:
+	// tipsify, cluster starts are written to clusters
+	static std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, std::vector<uint32_t>& clusters);
+	static void splitClusters(const std::vector<uint32_t>& indices, uint32_t vertexCount, std::vector<uint32_t>& clusters);
+	static void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& clusters);
+	static void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+public:
+	static void optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+	// just the triangle order, for index buffers sharing vertices that are already in place (LODs)
+	static void optimizeTriangles(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+	// simulates a fifo cache of cacheSize over the index buffer
+	static VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+};
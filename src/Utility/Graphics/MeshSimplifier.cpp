@@ -0,0 +1,493 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+
+// each level aims for this fraction of the triangles of the one before
+const float LOD_REDUCTION = 0.5f;
+
+// a level that can't get below this fraction of the one before isn't worth keeping
+const float LOD_MIN_REDUCTION = 0.85f;
+
+// coarsest a level may get, as a fraction of the mesh's largest extent
+const float LOD_MAX_ERROR = 0.05f;
+
+const uint32_t LOD_MIN_INDICES = 3 * 32;
+
+// how strongly border edges hold their place compared to the surface planes
+const double BORDER_WEIGHT = 10.0;
+
+// a collapse is rejected if it turns a triangle by more than about 75 degrees
+const double FLIP_THRESHOLD = 0.25;
+
+enum VertexKind : unsigned char {
+    VERTEX_MANIFOLD,
+    VERTEX_BORDER,
+    VERTEX_LOCKED
+};
+
+// symmetric 4x4 plane quadric, weight is the area it was summed over so errors come out as a mean squared distance
+struct Quadric {
+    double a00, a01, a02, a11, a12, a22;
+    double b0, b1, b2;
+    double c;
+    double weight;
+};
+
+struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double cost;
+};
+
+static void addPlane(Quadric& quadric, const double normal[3], double distance, double weight)
+{
+    quadric.a00 += weight * normal[0] * normal[0];
+    quadric.a01 += weight * normal[0] * normal[1];
+    quadric.a02 += weight * normal[0] * normal[2];
+    quadric.a11 += weight * normal[1] * normal[1];
+    quadric.a12 += weight * normal[1] * normal[2];
+    quadric.a22 += weight * normal[2] * normal[2];
+    quadric.b0 += weight * normal[0] * distance;
+    quadric.b1 += weight * normal[1] * distance;
+    quadric.b2 += weight * normal[2] * distance;
+    quadric.c += weight * distance * distance;
+    quadric.weight += weight;
+}
+
+static void addQuadric(Quadric& quadric, const Quadric& other)
+{
+    quadric.a00 += other.a00;
+    quadric.a01 += other.a01;
+    quadric.a02 += other.a02;
+    quadric.a11 += other.a11;
+    quadric.a12 += other.a12;
+    quadric.a22 += other.a22;
+    quadric.b0 += other.b0;
+    quadric.b1 += other.b1;
+    quadric.b2 += other.b2;
+    quadric.c += other.c;
+    quadric.weight += other.weight;
+}
+
+static double quadricError(const Quadric& quadric, const Vector3& position)
+{
+    double x = position[0];
+    double y = position[1];
+    double z = position[2];
+
+    double error = quadric.a00 * x * x + quadric.a11 * y * y + quadric.a22 * z * z
+        + 2.0 * (quadric.a01 * x * y + quadric.a02 * x * z + quadric.a12 * y * z)
+        + 2.0 * (quadric.b0 * x + quadric.b1 * y + quadric.b2 * z) + quadric.c;
+
+    return quadric.weight > 0.0 ? std::fabs(error) / quadric.weight : 0.0;
+}
+
+static void triangleNormal(const Vector3& p0, const Vector3& p1, const Vector3& p2, double normal[3])
+{
+    double e1[3] = { (double)p1[0] - p0[0], (double)p1[1] - p0[1], (double)p1[2] - p0[2] };
+    double e2[3] = { (double)p2[0] - p0[0], (double)p2[1] - p0[1], (double)p2[2] - p0[2] };
+
+    normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+static uint64_t edgeKey(uint32_t from, uint32_t to)
+{
+    return ((uint64_t)from << 32) | to;
+}
+
+void MeshSimplifier::classifyVertices(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, std::vector<unsigned char>& kinds)
+{
+    kinds.assign(vertices.size(), VERTEX_MANIFOLD);
+
+    // vertices sharing a position are the sides of a seam, moving one would tear it open
+    std::unordered_map<Vector3, uint32_t> positions;
+    positions.reserve(vertices.size());
+
+    for (uint32_t v = 0; v < vertices.size(); v++)
+    {
+        auto inserted = positions.emplace(vertices[v].pos, v);
+
+        if (!inserted.second)
+        {
+            kinds[v] = VERTEX_LOCKED;
+            kinds[inserted.first->second] = VERTEX_LOCKED;
+        }
+    }
+
+    std::unordered_set<uint64_t> edges;
+    edges.reserve(indices.size());
+
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        uint32_t from = indices[i];
+        uint32_t to = indices[i - i % 3 + (i + 1) % 3];
+
+        // the same directed edge twice means more than two triangles on it
+        if (!edges.insert(edgeKey(from, to)).second)
+        {
+            kinds[from] = VERTEX_LOCKED;
+            kinds[to] = VERTEX_LOCKED;
+        }
+    }
+
+    // a border vertex has exactly one border edge out and one in, anything else is a corner where borders meet
+    std::vector<uint32_t> borderOut(vertices.size(), 0);
+    std::vector<uint32_t> borderIn(vertices.size(), 0);
+
+    for (uint64_t edge : edges)
+    {
+        uint32_t from = (uint32_t)(edge >> 32);
+        uint32_t to = (uint32_t)edge;
+
+        if (edges.find(edgeKey(to, from)) == edges.end())
+        {
+            borderOut[from]++;
+            borderIn[to]++;
+        }
+    }
+
+    for (uint32_t v = 0; v < vertices.size(); v++)
+    {
+        if (kinds[v] == VERTEX_LOCKED || (borderOut[v] == 0 && borderIn[v] == 0))
+        {
+            continue;
+        }
+
+        kinds[v] = borderOut[v] == 1 && borderIn[v] == 1 ? VERTEX_BORDER : VERTEX_LOCKED;
+    }
+}
+
+float MeshSimplifier::simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t targetIndexCount, float maxError,
+    std::vector<uint32_t>& result)
+{
+    result = indices;
+
+    std::vector<unsigned char> kinds;
+    classifyVertices(vertices, indices, kinds);
+
+    std::vector<Quadric> quadrics(vertices.size(), Quadric{});
+
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        double normal[3];
+        triangleNormal(vertices[indices[i]].pos, vertices[indices[i + 1]].pos, vertices[indices[i + 2]].pos, normal);
+
+        double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+        if (length == 0.0)
+        {
+            continue;
+        }
+
+        for (int c = 0; c < 3; c++)
+        {
+            normal[c] /= length;
+        }
+
+        const Vector3& p0 = vertices[indices[i]].pos;
+        double distance = -(normal[0] * p0[0] + normal[1] * p0[1] + normal[2] * p0[2]);
+
+        for (int k = 0; k < 3; k++)
+        {
+            addPlane(quadrics[indices[i + k]], normal, distance, length * 0.5);
+        }
+    }
+
+    double maxCost = (double)maxError * maxError;
+    double reachedCost = 0.0;
+
+    std::vector<uint32_t> remap(vertices.size());
+    std::vector<unsigned char> touched(vertices.size());
+    std::vector<uint32_t> adjacencyOffsets(vertices.size() + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<Collapse> collapses;
+    std::unordered_set<uint64_t> edges;
+
+    bool bordersAdded = false;
+
+    while (result.size() > targetIndexCount)
+    {
+        edges.clear();
+
+        for (size_t i = 0; i < result.size(); i++)
+        {
+            edges.insert(edgeKey(result[i], result[i - i % 3 + (i + 1) % 3]));
+        }
+
+        // border edges get a plane standing up along them, so collapses along the border keep its shape.
+        // only once, from the mesh as it came in
+        if (!bordersAdded)
+        {
+            for (size_t i = 0; i < result.size(); i++)
+            {
+                uint32_t from = result[i];
+                uint32_t to = result[i - i % 3 + (i + 1) % 3];
+                uint32_t other = result[i - i % 3 + (i + 2) % 3];
+
+                if (edges.find(edgeKey(to, from)) != edges.end())
+                {
+                    continue;
+                }
+
+                const Vector3& p0 = vertices[from].pos;
+                const Vector3& p1 = vertices[to].pos;
+
+                double normal[3];
+                triangleNormal(p0, p1, vertices[other].pos, normal);
+
+                double edge[3] = { (double)p1[0] - p0[0], (double)p1[1] - p0[1], (double)p1[2] - p0[2] };
+                double edgeLengthSquared = edge[0] * edge[0] + edge[1] * edge[1] + edge[2] * edge[2];
+
+                double plane[3] = {
+                    edge[1] * normal[2] - edge[2] * normal[1],
+                    edge[2] * normal[0] - edge[0] * normal[2],
+                    edge[0] * normal[1] - edge[1] * normal[0]
+                };
+                double length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+
+                if (length == 0.0)
+                {
+                    continue;
+                }
+
+                for (int c = 0; c < 3; c++)
+                {
+                    plane[c] /= length;
+                }
+
+                double distance = -(plane[0] * p0[0] + plane[1] * p0[1] + plane[2] * p0[2]);
+
+                addPlane(quadrics[from], plane, distance, edgeLengthSquared * BORDER_WEIGHT);
+                addPlane(quadrics[to], plane, distance, edgeLengthSquared * BORDER_WEIGHT);
+            }
+
+            bordersAdded = true;
+        }
+
+        // triangles around each vertex
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+
+        for (uint32_t index : result)
+        {
+            adjacencyOffsets[index + 1]++;
+        }
+
+        for (size_t v = 0; v < vertices.size(); v++)
+        {
+            adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        }
+
+        adjacency.resize(result.size());
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+
+        for (size_t i = 0; i < result.size(); i++)
+        {
+            adjacency[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        // every edge both ways, where the vertex kinds allow it
+        collapses.clear();
+
+        for (size_t i = 0; i < result.size(); i++)
+        {
+            uint32_t a = result[i];
+            uint32_t b = result[i - i % 3 + (i + 1) % 3];
+
+            bool border = edges.find(edgeKey(b, a)) == edges.end();
+
+            for (int direction = 0; direction < 2; direction++)
+            {
+                uint32_t from = direction == 0 ? a : b;
+                uint32_t to = direction == 0 ? b : a;
+
+                bool allowed = kinds[from] == VERTEX_MANIFOLD
+                    || (kinds[from] == VERTEX_BORDER && border && kinds[to] != VERTEX_MANIFOLD);
+
+                if (!allowed)
+                {
+                    continue;
+                }
+
+                Quadric quadric = quadrics[from];
+                addQuadric(quadric, quadrics[to]);
+
+                collapses.push_back({ from, to, quadricError(quadric, vertices[to].pos) });
+            }
+        }
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs) { return lhs.cost < rhs.cost; });
+
+        for (uint32_t v = 0; v < vertices.size(); v++)
+        {
+            remap[v] = v;
+        }
+
+        std::fill(touched.begin(), touched.end(), 0);
+
+        size_t triangleCount = result.size() / 3;
+        size_t targetTriangleCount = targetIndexCount / 3;
+        size_t collapsed = 0;
+
+        // cheapest first, each vertex takes part in at most one collapse per pass so the adjacency stays usable
+        for (const Collapse& collapse : collapses)
+        {
+            if (triangleCount <= targetTriangleCount || collapse.cost > maxCost)
+            {
+                break;
+            }
+
+            if (touched[collapse.from] || touched[collapse.to])
+            {
+                continue;
+            }
+
+            bool flipped = false;
+            size_t removed = 0;
+
+            for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1] && !flipped; a++)
+            {
+                uint32_t triangle = adjacency[a];
+                uint32_t corners[3] = { remap[result[triangle * 3]], remap[result[triangle * 3 + 1]], remap[result[triangle * 3 + 2]] };
+
+                if (corners[0] == corners[1] || corners[1] == corners[2] || corners[2] == corners[0])
+                {
+                    continue;
+                }
+
+                if (corners[0] == collapse.to || corners[1] == collapse.to || corners[2] == collapse.to)
+                {
+                    removed++;
+                    continue;
+                }
+
+                double before[3];
+                double after[3];
+                triangleNormal(vertices[corners[0]].pos, vertices[corners[1]].pos, vertices[corners[2]].pos, before);
+
+                for (int k = 0; k < 3; k++)
+                {
+                    corners[k] = corners[k] == collapse.from ? collapse.to : corners[k];
+                }
+
+                triangleNormal(vertices[corners[0]].pos, vertices[corners[1]].pos, vertices[corners[2]].pos, after);
+
+                double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+                double lengths = std::sqrt((before[0] * before[0] + before[1] * before[1] + before[2] * before[2])
+                    * (after[0] * after[0] + after[1] * after[1] + after[2] * after[2]));
+
+                flipped = dot <= FLIP_THRESHOLD * lengths;
+            }
+
+            if (flipped)
+            {
+                continue;
+            }
+
+            remap[collapse.from] = collapse.to;
+            addQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+
+            touched[collapse.from] = 1;
+            touched[collapse.to] = 1;
+
+            triangleCount -= removed;
+            reachedCost = std::max(reachedCost, collapse.cost);
+            collapsed++;
+        }
+
+        if (collapsed == 0)
+        {
+            break;
+        }
+
+        // collapsed triangles have two corners on the same vertex now
+        size_t write = 0;
+
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            uint32_t a = remap[result[i]];
+            uint32_t b = remap[result[i + 1]];
+            uint32_t c = remap[result[i + 2]];
+
+            if (a == b || b == c || c == a)
+            {
+                continue;
+            }
+
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+
+        result.resize(write);
+    }
+
+    return static_cast<float>(std::sqrt(reachedCost));
+}
+
+uint32_t MeshSimplifier::buildLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, MeshLod lods[MAX_MESH_LODS])
+{
+    lods[0] = { 0, static_cast<uint32_t>(indices.size()), 0.0f, 0, 0 };
+    uint32_t lodCount = 1;
+
+    float extent = 0.0f;
+
+    if (!vertices.empty())
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            float minimum = std::numeric_limits<float>::max();
+            float maximum = std::numeric_limits<float>::lowest();
+
+            for (const Vertex& vertex : vertices)
+            {
+                minimum = std::min(minimum, vertex.pos[c]);
+                maximum = std::max(maximum, vertex.pos[c]);
+            }
+
+            extent = std::max(extent, maximum - minimum);
+        }
+    }
+
+    float maxError = extent * LOD_MAX_ERROR;
+
+    // each level is simplified from the one before, so its error is at most the sum of the steps
+    std::vector<uint32_t> previous(indices);
+    std::vector<uint32_t> level;
+    float error = 0.0f;
+
+    while (lodCount < MAX_MESH_LODS)
+    {
+        uint32_t targetIndexCount = static_cast<uint32_t>(previous.size() / 3 * LOD_REDUCTION) * 3;
+
+        if (targetIndexCount < LOD_MIN_INDICES || error >= maxError)
+        {
+            break;
+        }
+
+        float levelError = simplify(vertices, previous, targetIndexCount, maxError - error, level);
+
+        if (level.size() > previous.size() * LOD_MIN_REDUCTION)
+        {
+            break;
+        }
+
+        error += levelError;
+
+        MeshOptimizer::optimizeTriangles(vertices, level);
+
+        lods[lodCount] = { static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(level.size()), error, 0, 0 };
+        lodCount++;
+
+        indices.insert(indices.end(), level.begin(), level.end());
+        previous.swap(level);
+    }
+
+    return lodCount;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Vertex.h"
+
+// most levels a mesh keeps, the full mesh included
+const uint32_t MAX_MESH_LODS = 8;
+
+// One level of detail, a range of the mesh's index buffer. Every level draws from the same vertices.
+struct MeshLod {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error; // furthest this level may be from the full mesh, in mesh units
+	uint32_t firstMeshlet; // filled in by MeshletBuilder
+	uint32_t meshletCount;
+};
+
+// Quadric error metric edge collapse (Garland & Heckbert). Vertices are never moved or added, a collapse just points
+// one vertex's triangles at a neighbour, so the levels only need new indices.
+// Vertices on uv / normal seams and non manifold ones stay put, border vertices only slide along the border.
+class MeshSimplifier {
+
+private:
+	static void classifyVertices(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, std::vector<unsigned char>& kinds);
+
+public:
+	// collapses edges until there are targetIndexCount indices left or the next collapse would be off by more than
+	// maxError, returns the error reached
+	static float simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t targetIndexCount, float maxError,
+		std::vector<uint32_t>& result);
+
+	// lod 0 is indices as they are, each level after has about half the triangles of the one before.
+	// the levels are appended to indices, returns how many levels there are
+	static uint32_t buildLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, MeshLod lods[MAX_MESH_LODS]);
+};
@@ -0,0 +1,164 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+Meshlet MeshletBuilder::computeBounds(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t firstIndex, uint32_t indexCount)
+{
+    Meshlet meshlet{};
+    meshlet.firstIndex = firstIndex;
+    meshlet.indexCount = indexCount;
+
+    // sphere around the box of the corners, loose but cheap and never misses one
+    float boundsMin[3] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+    float boundsMax[3] = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest() };
+
+    for (uint32_t i = firstIndex; i < firstIndex + indexCount; i++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            boundsMin[c] = std::min(boundsMin[c], vertices[indices[i]].pos[c]);
+            boundsMax[c] = std::max(boundsMax[c], vertices[indices[i]].pos[c]);
+        }
+    }
+
+    for (int c = 0; c < 3; c++)
+    {
+        meshlet.center[c] = 0.5f * (boundsMin[c] + boundsMax[c]);
+    }
+
+    float radiusSquared = 0.0f;
+
+    for (uint32_t i = firstIndex; i < firstIndex + indexCount; i++)
+    {
+        float distanceSquared = 0.0f;
+
+        for (int c = 0; c < 3; c++)
+        {
+            float d = vertices[indices[i]].pos[c] - meshlet.center[c];
+            distanceSquared += d * d;
+        }
+
+        radiusSquared = std::max(radiusSquared, distanceSquared);
+    }
+
+    meshlet.radius = std::sqrt(radiusSquared);
+
+    // cone around the triangle normals, the axis is their average and the widest one sets the angle
+    std::vector<float> normals;
+    normals.reserve(indexCount);
+
+    float axis[3] = { 0.0f, 0.0f, 0.0f };
+
+    for (uint32_t i = firstIndex; i < firstIndex + indexCount; i += 3)
+    {
+        const Vector3& p0 = vertices[indices[i]].pos;
+        const Vector3& p1 = vertices[indices[i + 1]].pos;
+        const Vector3& p2 = vertices[indices[i + 2]].pos;
+
+        float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        float normal[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+
+        float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+        if (length == 0.0f)
+        {
+            continue;
+        }
+
+        for (int c = 0; c < 3; c++)
+        {
+            normals.push_back(normal[c] / length);
+            axis[c] += normal[c] / length;
+        }
+    }
+
+    float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    meshlet.coneCutoff = 2.0f;
+
+    if (axisLength == 0.0f)
+    {
+        return meshlet;
+    }
+
+    float minimumDot = 1.0f;
+
+    for (int c = 0; c < 3; c++)
+    {
+        meshlet.coneAxis[c] = axis[c] / axisLength;
+    }
+
+    for (size_t n = 0; n < normals.size(); n += 3)
+    {
+        float dot = normals[n] * meshlet.coneAxis[0] + normals[n + 1] * meshlet.coneAxis[1] + normals[n + 2] * meshlet.coneAxis[2];
+        minimumDot = std::min(minimumDot, dot);
+    }
+
+    // a cone wider than a hemisphere always has a triangle facing the camera
+    if (minimumDot > 0.0f)
+    {
+        meshlet.coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+    }
+
+    return meshlet;
+}
+
+void MeshletBuilder::build(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, MeshLod* lods, uint32_t lodCount,
+    std::vector<Meshlet>& meshlets)
+{
+    meshlets.clear();
+
+    // which meshlet last used each vertex, so counting a meshlet's vertices doesn't need a set
+    std::vector<uint32_t> usedBy(vertices.size(), UINT32_MAX);
+
+    for (uint32_t l = 0; l < lodCount; l++)
+    {
+        MeshLod& lod = lods[l];
+        lod.firstMeshlet = static_cast<uint32_t>(meshlets.size());
+
+        uint32_t start = lod.firstIndex;
+        uint32_t end = lod.firstIndex + lod.indexCount;
+        uint32_t meshletStart = start;
+        uint32_t vertexCount = 0;
+        uint32_t stamp = static_cast<uint32_t>(meshlets.size());
+
+        for (uint32_t i = start; i < end; i += 3)
+        {
+            uint32_t newVertices = 0;
+
+            for (int k = 0; k < 3; k++)
+            {
+                // a triangle that repeats a vertex only counts it once
+                bool repeated = (k > 0 && indices[i + k] == indices[i]) || (k > 1 && indices[i + k] == indices[i + 1]);
+                newVertices += usedBy[indices[i + k]] != stamp && !repeated ? 1 : 0;
+            }
+
+            if (vertexCount + newVertices > MESHLET_MAX_VERTICES || (i - meshletStart) / 3 >= MESHLET_MAX_TRIANGLES)
+            {
+                meshlets.push_back(computeBounds(vertices, indices, meshletStart, i - meshletStart));
+
+                meshletStart = i;
+                vertexCount = 0;
+                stamp = static_cast<uint32_t>(meshlets.size());
+            }
+
+            for (int k = 0; k < 3; k++)
+            {
+                if (usedBy[indices[i + k]] != stamp)
+                {
+                    usedBy[indices[i + k]] = stamp;
+                    vertexCount++;
+                }
+            }
+        }
+
+        if (end > meshletStart)
+        {
+            meshlets.push_back(computeBounds(vertices, indices, meshletStart, end - meshletStart));
+        }
+
+        lod.meshletCount = static_cast<uint32_t>(meshlets.size()) - lod.firstMeshlet;
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Vertex.h"
+#include "MeshSimplifier.h"
+
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// A small run of a mesh's index buffer with what's needed to skip drawing it, in mesh space.
+struct Meshlet {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float center[3];
+	float radius;
+	float coneAxis[3]; // average facing of the triangles
+	float coneCutoff; // sine of the cone's half angle, above 1 when the triangles face too many ways to ever be back facing
+};
+
+// Cuts each lod's index range into meshlets of at most MESHLET_MAX_VERTICES vertices and MESHLET_MAX_TRIANGLES triangles.
+// The triangles keep the order the optimizer gave them, so a meshlet is just a contiguous range and the normal index
+// buffer draws it, no mesh shaders needed.
+class MeshletBuilder {
+
+private:
+	static Meshlet computeBounds(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t firstIndex, uint32_t indexCount);
+
+public:
+	// writes each lod's range of meshlets into it
+	static void build(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, MeshLod* lods, uint32_t lodCount,
+		std::vector<Meshlet>& meshlets);
+};
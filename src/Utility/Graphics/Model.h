@@ -3,30 +3,28 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
-#include <vector>
-#include "Vertex.h"
+#include <cstdint>
 
+#include "ResourceManager.h"
+#include "../Math/Matrix4.h"
+
+// One object in the scene. The mesh and material are shared with every other model that loaded the same files, the model
+// only holds references to them.
 struct Model
 {
-	std::vector<Vertex> vertices;
-	std::vector<uint32_t> indices;
-
-	VkBuffer vertexBuffer;
-	VkDeviceMemory vertexBufferMemory;
-	VkBuffer indexBuffer;
-	VkDeviceMemory indexBufferMemory;
-
-	VkImage textureImage;
-	VkDeviceMemory textureImageMemory;
-	VkImageView textureImageView;
-	VkSampler textureSampler;
+	MeshHandle mesh;
+	MaterialHandle material;
+	Matrix4 transform;
+};
 
-	Model()
-	{
-		vertices = std::vector<Vertex>();
-		indices = std::vector<uint32_t>();
+typedef SlotHandle ModelHandle;
 
-
-	}
-
-};
\ No newline at end of file
+// what a frame draws of one model, filled in when its uniforms are pushed and replayed when the commands are recorded
+struct ModelDraw
+{
+	uint32_t model; // packed index into DLPipeline::models
+	VkPipeline pipeline;
+	uint32_t uniformOffset;
+	uint32_t firstDraw; // range of DLPipeline::meshletDraws
+	uint32_t drawCount;
+};
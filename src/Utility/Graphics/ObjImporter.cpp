@@ -0,0 +1,355 @@
+#include "ObjImporter.h"
+#include "VertexTable.h"
+#include "../VirtualFileSystem.h"
+
+#include <charconv>
+#include <cstring>
+#include <algorithm>
+
+// below this a chunk isn't worth a job
+const size_t OBJ_MIN_CHUNK_SIZE = 1024 * 1024;
+
+struct ObjCorner {
+    uint32_t position;
+    uint32_t texCoord; // UINT32_MAX when the face has none
+};
+
+struct ObjChunk {
+    const char* begin;
+    const char* end;
+
+    // counting pass
+    uint32_t positionCount;
+    uint32_t texCoordCount;
+    uint32_t indexCount;
+
+    // where this chunk's data starts in the whole file's arrays
+    uint32_t positionBase;
+    uint32_t texCoordBase;
+    uint32_t indexBase;
+
+    std::vector<ObjCorner> corners; // three per triangle
+    std::vector<Vertex> vertices; // unique within the chunk
+    std::vector<uint32_t> localIndices; // into vertices
+    std::vector<uint32_t> remap; // chunk vertex -> merged vertex
+};
+
+static bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char* skipSpace(const char* cursor, const char* end)
+{
+    while (cursor < end && isSpace(*cursor))
+    {
+        cursor++;
+    }
+    return cursor;
+}
+
+static const char* nextLine(const char* cursor, const char* end)
+{
+    const char* newline = (const char*)memchr(cursor, '\n', end - cursor);
+    return newline ? newline + 1 : end;
+}
+
+static const char* parseFloat(const char* cursor, const char* end, float& value)
+{
+    cursor = skipSpace(cursor, end);
+
+    // from_chars doesn't take a leading plus
+    if (cursor < end && *cursor == '+')
+    {
+        cursor++;
+    }
+
+    std::from_chars_result result = std::from_chars(cursor, end, value);
+
+    if (result.ec != std::errc())
+    {
+        throw std::runtime_error("malformed number in obj!");
+    }
+
+    return result.ptr;
+}
+
+// obj indices are 1 based, negative ones count back from the last element defined before the line
+static uint32_t resolveIndex(int32_t index, uint32_t definedBefore)
+{
+    int64_t resolved = index > 0 ? (int64_t)index - 1 : (int64_t)definedBefore + index;
+
+    if (index == 0 || resolved < 0 || resolved >= definedBefore)
+    {
+        throw std::runtime_error("obj face index out of range!");
+    }
+
+    return static_cast<uint32_t>(resolved);
+}
+
+static void countChunk(ObjChunk& chunk)
+{
+    chunk.positionCount = 0;
+    chunk.texCoordCount = 0;
+    chunk.indexCount = 0;
+
+    for (const char* line = chunk.begin; line < chunk.end; line = nextLine(line, chunk.end))
+    {
+        const char* cursor = skipSpace(line, chunk.end);
+
+        if (chunk.end - cursor < 2)
+        {
+            continue;
+        }
+
+        if (cursor[0] == 'v' && isSpace(cursor[1]))
+        {
+            chunk.positionCount++;
+        }
+        else if (cursor[0] == 'v' && cursor[1] == 't')
+        {
+            chunk.texCoordCount++;
+        }
+        else if (cursor[0] == 'f' && isSpace(cursor[1]))
+        {
+            uint32_t cornerCount = 0;
+            const char* lineEnd = nextLine(cursor, chunk.end);
+            cursor++;
+
+            while (true)
+            {
+                cursor = skipSpace(cursor, lineEnd);
+                if (cursor >= lineEnd || *cursor == '\n')
+                {
+                    break;
+                }
+
+                cornerCount++;
+                while (cursor < lineEnd && !isSpace(*cursor) && *cursor != '\n')
+                {
+                    cursor++;
+                }
+            }
+
+            if (cornerCount >= 3)
+            {
+                chunk.indexCount += (cornerCount - 2) * 3;
+            }
+        }
+    }
+}
+
+static void parseChunk(ObjChunk& chunk, std::vector<float>& positions, std::vector<float>& texCoords)
+{
+    uint32_t positionCount = chunk.positionBase;
+    uint32_t texCoordCount = chunk.texCoordBase;
+
+    chunk.corners.reserve(chunk.indexCount);
+
+    std::vector<ObjCorner> polygon;
+
+    for (const char* line = chunk.begin; line < chunk.end; line = nextLine(line, chunk.end))
+    {
+        const char* lineEnd = nextLine(line, chunk.end);
+        const char* cursor = skipSpace(line, lineEnd);
+
+        if (lineEnd - cursor < 2)
+        {
+            continue;
+        }
+
+        if (cursor[0] == 'v' && isSpace(cursor[1]))
+        {
+            float* position = &positions[positionCount * 3];
+            cursor = parseFloat(cursor + 1, lineEnd, position[0]);
+            cursor = parseFloat(cursor, lineEnd, position[1]);
+            parseFloat(cursor, lineEnd, position[2]);
+            positionCount++;
+        }
+        else if (cursor[0] == 'v' && cursor[1] == 't')
+        {
+            float* texCoord = &texCoords[texCoordCount * 2];
+            cursor = parseFloat(cursor + 2, lineEnd, texCoord[0]);
+            parseFloat(cursor, lineEnd, texCoord[1]);
+            texCoordCount++;
+        }
+        else if (cursor[0] == 'f' && isSpace(cursor[1]))
+        {
+            polygon.clear();
+            cursor++;
+
+            while (true)
+            {
+                cursor = skipSpace(cursor, lineEnd);
+                if (cursor >= lineEnd || *cursor == '\n')
+                {
+                    break;
+                }
+
+                // v, v/vt, v//vn or v/vt/vn
+                int32_t index = 0;
+                std::from_chars_result result = std::from_chars(cursor, lineEnd, index);
+                if (result.ec != std::errc())
+                {
+                    throw std::runtime_error("malformed face in obj!");
+                }
+                cursor = result.ptr;
+
+                ObjCorner corner{};
+                corner.position = resolveIndex(index, positionCount);
+                corner.texCoord = UINT32_MAX;
+
+                if (cursor < lineEnd && *cursor == '/' && cursor + 1 < lineEnd && cursor[1] != '/')
+                {
+                    result = std::from_chars(cursor + 1, lineEnd, index);
+                    if (result.ec != std::errc())
+                    {
+                        throw std::runtime_error("malformed face in obj!");
+                    }
+                    cursor = result.ptr;
+                    corner.texCoord = resolveIndex(index, texCoordCount);
+                }
+
+                // normals aren't used
+                while (cursor < lineEnd && !isSpace(*cursor) && *cursor != '\n')
+                {
+                    cursor++;
+                }
+
+                polygon.push_back(corner);
+            }
+
+            for (size_t i = 2; i < polygon.size(); i++)
+            {
+                chunk.corners.push_back(polygon[0]);
+                chunk.corners.push_back(polygon[i - 1]);
+                chunk.corners.push_back(polygon[i]);
+            }
+        }
+    }
+}
+
+static void deduplicateChunk(ObjChunk& chunk, const std::vector<float>& positions, const std::vector<float>& texCoords)
+{
+    VertexTable table(chunk.corners.size() / 4);
+    chunk.localIndices.resize(chunk.corners.size());
+
+    for (size_t i = 0; i < chunk.corners.size(); i++)
+    {
+        const ObjCorner& corner = chunk.corners[i];
+
+        Vertex vertex{};
+        vertex.pos = Vector3(positions[corner.position * 3 + 0], positions[corner.position * 3 + 1], positions[corner.position * 3 + 2]);
+
+        if (corner.texCoord != UINT32_MAX)
+        {
+            vertex.texCoord = Vector2(texCoords[corner.texCoord * 2 + 0], -1.0f * texCoords[corner.texCoord * 2 + 1]);
+        }
+        else
+        {
+            vertex.texCoord = Vector2(0.0f, 0.0f);
+        }
+
+        vertex.color = Vector3(1.0f, 1.0f, 1.0f);
+
+        chunk.localIndices[i] = table.insert(vertex);
+    }
+
+    chunk.corners = std::vector<ObjCorner>();
+    chunk.vertices = std::move(table.vertices);
+}
+
+void ObjImporter::import(const std::string& path, VirtualFileSystem* vfs, ThreadPool* threadPool, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+    MappedFile looseFile;
+    FileView file = vfs->open(path, looseFile);
+
+    if (!file.isValid())
+    {
+        throw std::runtime_error("failed to open " + path + "!");
+    }
+
+    const char* begin = (const char*)file.data;
+    const char* end = begin + file.size;
+
+    // cut at line breaks, a few chunks per thread so uneven ones even out
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(threadPool->getThreadCount() * 4, file.size / OBJ_MIN_CHUNK_SIZE));
+    size_t chunkSize = file.size / chunkCount;
+
+    std::vector<ObjChunk> chunks;
+    const char* chunkBegin = begin;
+
+    for (size_t i = 0; i < chunkCount && chunkBegin < end; i++)
+    {
+        const char* chunkEnd = i + 1 == chunkCount ? end : nextLine(std::max(chunkBegin, begin + (i + 1) * chunkSize), end);
+
+        ObjChunk chunk{};
+        chunk.begin = chunkBegin;
+        chunk.end = chunkEnd;
+        chunks.push_back(std::move(chunk));
+
+        chunkBegin = chunkEnd;
+    }
+
+    uint32_t jobCount = static_cast<uint32_t>(chunks.size());
+
+    threadPool->parallelFor(jobCount, [&](uint32_t i) { countChunk(chunks[i]); });
+
+    uint32_t totalPositions = 0;
+    uint32_t totalTexCoords = 0;
+    uint32_t totalIndices = 0;
+
+    for (ObjChunk& chunk : chunks)
+    {
+        chunk.positionBase = totalPositions;
+        chunk.texCoordBase = totalTexCoords;
+        chunk.indexBase = totalIndices;
+
+        totalPositions += chunk.positionCount;
+        totalTexCoords += chunk.texCoordCount;
+        totalIndices += chunk.indexCount;
+    }
+
+    // every chunk writes its own range of these, faces can refer to anything defined before them
+    std::vector<float> positions(totalPositions * 3);
+    std::vector<float> texCoords(totalTexCoords * 2);
+
+    threadPool->parallelFor(jobCount, [&](uint32_t i) { parseChunk(chunks[i], positions, texCoords); });
+    threadPool->parallelFor(jobCount, [&](uint32_t i) { deduplicateChunk(chunks[i], positions, texCoords); });
+
+    // vertices shared between chunks only get merged here, in chunk order so the result matches a serial import
+    size_t chunkVertexCount = 0;
+    for (ObjChunk& chunk : chunks)
+    {
+        chunkVertexCount += chunk.vertices.size();
+    }
+
+    VertexTable merged(chunkVertexCount);
+
+    for (ObjChunk& chunk : chunks)
+    {
+        chunk.remap.resize(chunk.vertices.size());
+
+        for (size_t i = 0; i < chunk.vertices.size(); i++)
+        {
+            chunk.remap[i] = merged.insert(chunk.vertices[i]);
+        }
+
+        chunk.vertices = std::vector<Vertex>();
+    }
+
+    indices.resize(totalIndices);
+
+    threadPool->parallelFor(jobCount, [&](uint32_t i)
+        {
+            ObjChunk& chunk = chunks[i];
+            uint32_t* out = indices.data() + chunk.indexBase;
+
+            for (size_t j = 0; j < chunk.localIndices.size(); j++)
+            {
+                out[j] = chunk.remap[chunk.localIndices[j]];
+            }
+        });
+
+    vertices = std::move(merged.vertices);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "Vertex.h"
+#include "../ThreadPool.h"
+#include "../VirtualFileSystem.h"
+
+// Wavefront obj import spread over the thread pool. The mapped file is cut into chunks at line breaks, which are counted,
+// parsed and deduplicated in parallel; a short serial merge then joins the per chunk vertices into one table.
+// Only positions and texture coordinates are read, polygons are fanned into triangles and groups/materials are ignored.
+class ObjImporter {
+
+public:
+	// vertices come out deduplicated in first use order, indices as a triangle list in file order
+	static void import(const std::string& path, VirtualFileSystem* vfs, ThreadPool* threadPool, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+};
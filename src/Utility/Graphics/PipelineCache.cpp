@@ -0,0 +1,146 @@
+#include "PipelineCache.h"
+#include "DLPipeline.h"
+#include "../Hash.h"
+
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <vector>
+
+const uint32_t PIPELINE_CACHE_VERSION = 1;
+
+
+PipelineCache::PipelineCache(DLPipeline* pipeline, const std::string& path)
+{
+    this->pipeline = pipeline;
+    this->path = path;
+    loadedHash = 0;
+
+    PipelineCacheHeader expected = currentHeader();
+
+    // machine specific, so always a loose file and never part of the archive
+    MappedFile file;
+    const PipelineCacheHeader* header = nullptr;
+    const unsigned char* data = nullptr;
+
+    if (file.open(path) && file.size() >= sizeof(PipelineCacheHeader))
+    {
+        header = (const PipelineCacheHeader*)file.data();
+        data = (const unsigned char*)file.data() + sizeof(PipelineCacheHeader);
+
+        // another gpu or a driver update, the driver would reject or miscompile the data
+        bool valid = memcmp(header->magic, expected.magic, 4) == 0 && header->version == expected.version
+            && header->vendorID == expected.vendorID && header->deviceID == expected.deviceID
+            && header->driverVersion == expected.driverVersion
+            && memcmp(header->pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) == 0
+            && header->dataSize == file.size() - sizeof(PipelineCacheHeader)
+            && header->dataHash == hashBytes(data, static_cast<size_t>(header->dataSize));
+
+        if (!valid)
+        {
+            std::cerr << path << ": saved by another device or driver, starting empty" << std::endl;
+            header = nullptr;
+        }
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = header != nullptr ? static_cast<size_t>(header->dataSize) : 0;
+    cacheInfo.pInitialData = header != nullptr ? data : nullptr;
+
+    if (vkCreatePipelineCache(pipeline->device, &cacheInfo, nullptr, &cache) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create pipeline cache!");
+    }
+
+    if (header != nullptr)
+    {
+        loadedHash = header->dataHash;
+    }
+}
+
+PipelineCache::~PipelineCache()
+{
+
+}
+
+PipelineCacheHeader PipelineCache::currentHeader()
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(pipeline->physicalDevice, &properties);
+
+    PipelineCacheHeader header{};
+    memcpy(header.magic, "DLPC", 4);
+    header.version = PIPELINE_CACHE_VERSION;
+    header.vendorID = properties.vendorID;
+    header.deviceID = properties.deviceID;
+    header.driverVersion = properties.driverVersion;
+    memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+    return header;
+}
+
+void PipelineCache::save()
+{
+    size_t dataSize = 0;
+
+    if (vkGetPipelineCacheData(pipeline->device, cache, &dataSize, nullptr) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to read pipeline cache!");
+    }
+
+    std::vector<char> data(dataSize);
+
+    if (vkGetPipelineCacheData(pipeline->device, cache, &dataSize, data.data()) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to read pipeline cache!");
+    }
+
+    PipelineCacheHeader header = currentHeader();
+    header.dataSize = dataSize;
+    header.dataHash = hashBytes(data.data(), dataSize);
+
+    // nothing new was compiled since it was loaded
+    if (header.dataHash == loadedHash)
+    {
+        return;
+    }
+
+    // written aside and moved into place, so a half written file is never loaded
+    std::string temporaryPath = path + ".tmp";
+
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+
+        if (!file.is_open())
+        {
+            throw std::runtime_error("failed to write pipeline cache!");
+        }
+
+        file.write((const char*)&header, sizeof(header));
+        file.write(data.data(), static_cast<std::streamsize>(dataSize));
+
+        if (!file)
+        {
+            throw std::runtime_error("failed to write pipeline cache!");
+        }
+    }
+
+    std::filesystem::rename(temporaryPath, path);
+    loadedHash = header.dataHash;
+}
+
+void PipelineCache::destroyPipelineCache()
+{
+    // not being able to save it only costs the next launch its compiles
+    try
+    {
+        save();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << path << ": " << e.what() << std::endl;
+    }
+
+    vkDestroyPipelineCache(pipeline->device, cache, nullptr);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <string>
+#include <stdexcept>
+
+class DLPipeline;
+
+// layout of a .dlcache file: this header, then the driver's own pipeline cache data
+struct PipelineCacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint32_t driverVersion;
+	uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+	uint64_t dataSize;
+	uint64_t dataHash;
+};
+
+// The VkPipelineCache every pipeline is created with, kept on disk between launches so the driver only compiles a shader the
+// first time it sees it. The data is only handed back to the driver if it was saved by the same device and driver version,
+// and intact. A file that doesn't match is ignored and replaced on the next save.
+// Creating pipelines with the cache from several threads at once is fine, Vulkan synchronizes it internally.
+class PipelineCache {
+
+private:
+	DLPipeline* pipeline;
+	std::string path;
+	VkPipelineCache cache;
+	uint64_t loadedHash; // what's on disk, saving the same data again is skipped
+
+	// what the header has to match, for the device the pipeline picked
+	PipelineCacheHeader currentHeader();
+
+public:
+	PipelineCache(DLPipeline* pipeline, const std::string& path);
+	~PipelineCache();
+
+	VkPipelineCache getCache() { return cache; }
+
+	// writes what the driver has compiled so far
+	void save();
+
+	// saves, then destroys the cache
+	void destroyPipelineCache();
+};
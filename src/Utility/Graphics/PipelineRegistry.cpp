@@ -0,0 +1,246 @@
+#include "PipelineRegistry.h"
+#include "DLPipeline.h"
+#include "../Hash.h"
+
+
+PipelineRegistry::PipelineRegistry(DLPipeline* pipeline, ThreadPool* threadPool, uint32_t frameCount)
+{
+    this->pipeline = pipeline;
+    this->threadPool = threadPool;
+    this->frameCount = frameCount;
+}
+
+PipelineRegistry::~PipelineRegistry()
+{
+
+}
+
+uint64_t PipelineRegistry::hashState(const PipelineState& state)
+{
+    // field by field, the structs have padding and the format has fields that don't change the pipeline
+    uint64_t hash = hashBytes(state.vertexShader.data(), state.vertexShader.size());
+    hash = hashBytes(state.fragmentShader.data(), state.fragmentShader.size(), hash);
+
+    for (const std::string& define : state.defines)
+    {
+        hash = hashBytes(define.c_str(), define.size() + 1, hash);
+    }
+
+    uint32_t layout[] = {
+        static_cast<uint32_t>(state.format.position), static_cast<uint32_t>(state.format.texCoord), state.format.hasColor != 0 ? 1u : 0u,
+        state.format.stride, state.format.texCoordOffset, state.format.colorOffset
+    };
+    hash = hashBytes(layout, sizeof(layout), hash);
+
+    uint32_t fixedFunction[] = {
+        state.blendEnable ? 1u : 0u, state.depthTest ? 1u : 0u, state.depthWrite ? 1u : 0u,
+        static_cast<uint32_t>(state.cullMode), static_cast<uint32_t>(state.samples)
+    };
+    hash = hashBytes(fixedFunction, sizeof(fixedFunction), hash);
+
+    return hashBytes(state.specialization.data(), state.specialization.size() * sizeof(uint32_t), hash);
+}
+
+bool PipelineRegistry::sameState(const PipelineState& a, const PipelineState& b)
+{
+    return a.vertexShader == b.vertexShader && a.fragmentShader == b.fragmentShader && a.defines == b.defines
+        && VertexPacker::sameLayout(a.format, b.format)
+        && a.blendEnable == b.blendEnable && a.depthTest == b.depthTest && a.depthWrite == b.depthWrite && a.cullMode == b.cullMode
+        && a.samples == b.samples && a.specialization == b.specialization;
+}
+
+PipelineId PipelineRegistry::find(const PipelineState& state, bool& added)
+{
+    uint64_t hash = hashState(state);
+    std::vector<PipelineId>& candidates = hashes[hash];
+
+    for (PipelineId id : candidates)
+    {
+        if (sameState(entries[id].state, state))
+        {
+            added = false;
+            return id;
+        }
+    }
+
+    Entry entry{};
+    entry.state = state;
+    entry.hash = hash;
+    entry.pipeline = VK_NULL_HANDLE;
+    entry.compileStale = false;
+
+    PipelineId id = static_cast<PipelineId>(entries.size());
+    entries.push_back(entry);
+    candidates.push_back(id);
+
+    added = true;
+    return id;
+}
+
+void PipelineRegistry::startCompile(Entry& entry)
+{
+    entry.compileStale = false;
+
+    DLPipeline* pipeline = this->pipeline;
+    PipelineState state = entry.state;
+
+    // creating pipelines from several threads is fine, the shared pipeline cache is synchronized by the driver
+    entry.compile = threadPool->submit([pipeline, state]()
+        {
+            return pipeline->createGraphicsPipeline(state);
+        }).share();
+}
+
+PipelineId PipelineRegistry::request(const PipelineState& state)
+{
+    bool added;
+    PipelineId id = find(state, added);
+
+    if (added)
+    {
+        startCompile(entries[id]);
+    }
+
+    return id;
+}
+
+PipelineId PipelineRegistry::build(const PipelineState& state)
+{
+    bool added;
+    PipelineId id = find(state, added);
+
+    if (added)
+    {
+        entries[id].pipeline = pipeline->createGraphicsPipeline(state);
+    }
+    else if (entries[id].compile.valid())
+    {
+        entries[id].compile.wait();
+        finishCompile(entries[id]);
+    }
+
+    return id;
+}
+
+VkPipeline PipelineRegistry::get(PipelineId id)
+{
+    return id < entries.size() ? entries[id].pipeline : VK_NULL_HANDLE;
+}
+
+bool PipelineRegistry::rebuild(const std::string& shaderPath)
+{
+    bool used = false;
+
+    for (Entry& entry : entries)
+    {
+        if (entry.state.vertexShader != shaderPath && entry.state.fragmentShader != shaderPath)
+        {
+            continue;
+        }
+
+        used = true;
+
+        // editors write a file more than once, the running compile may have read a half saved shader
+        if (entry.compile.valid())
+        {
+            entry.compileStale = true;
+            continue;
+        }
+
+        startCompile(entry);
+    }
+
+    return used;
+}
+
+void PipelineRegistry::update()
+{
+    // replaced pipelines go once the frames recorded with them are done
+    for (size_t i = 0; i < retiredPipelines.size();)
+    {
+        if (--retiredPipelines[i].second > 0)
+        {
+            i++;
+            continue;
+        }
+
+        vkDestroyPipeline(pipeline->device, retiredPipelines[i].first, nullptr);
+
+        retiredPipelines[i] = retiredPipelines.back();
+        retiredPipelines.pop_back();
+    }
+
+    for (Entry& entry : entries)
+    {
+        if (entry.compile.valid() && entry.compile.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        {
+            finishCompile(entry);
+        }
+    }
+}
+
+void PipelineRegistry::finishCompile(Entry& entry)
+{
+    try
+    {
+        VkPipeline compiled = entry.compile.get();
+
+        if (entry.pipeline != VK_NULL_HANDLE)
+        {
+            retiredPipelines.push_back(std::make_pair(entry.pipeline, frameCount));
+        }
+
+        entry.pipeline = compiled;
+    }
+    catch (const std::exception& e)
+    {
+        // keep drawing with the old one until the shader is fixed, with none the draws stay skipped
+        std::cerr << entry.state.vertexShader << ", " << entry.state.fragmentShader << ": " << e.what() << std::endl;
+    }
+
+    entry.compile = std::shared_future<VkPipeline>();
+
+    if (entry.compileStale)
+    {
+        startCompile(entry);
+    }
+}
+
+void PipelineRegistry::destroyPipelineRegistry()
+{
+    for (Entry& entry : entries)
+    {
+        if (!entry.compile.valid())
+        {
+            continue;
+        }
+
+        entry.compile.wait();
+
+        try
+        {
+            vkDestroyPipeline(pipeline->device, entry.compile.get(), nullptr);
+        }
+        catch (const std::exception&)
+        {
+            // failed, nothing was created
+        }
+    }
+
+    for (Entry& entry : entries)
+    {
+        if (entry.pipeline != VK_NULL_HANDLE)
+        {
+            vkDestroyPipeline(pipeline->device, entry.pipeline, nullptr);
+        }
+    }
+
+    for (const std::pair<VkPipeline, uint32_t>& retiredPipeline : retiredPipelines)
+    {
+        vkDestroyPipeline(pipeline->device, retiredPipeline.first, nullptr);
+    }
+
+    entries.clear();
+    hashes.clear();
+    retiredPipelines.clear();
+}
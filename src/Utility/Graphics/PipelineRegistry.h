@@ -0,0 +1,93 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <future>
+#include <stdexcept>
+
+#include "VertexPacker.h"
+#include "../ThreadPool.h"
+
+class DLPipeline;
+
+typedef uint32_t PipelineId;
+
+// Everything a graphics pipeline is built from that can differ between two of them. The render pass, pipeline layout and
+// dynamic viewport are the same for all.
+struct PipelineState {
+	std::string vertexShader;
+	std::string fragmentShader;
+	std::vector<std::string> defines; // compiled into both shaders, each one is its own variant
+	VertexFormat format; // only the layout counts, see VertexPacker::sameLayout
+	bool blendEnable;
+	bool depthTest;
+	bool depthWrite;
+	VkCullModeFlags cullMode;
+	VkSampleCountFlagBits samples;
+	std::vector<uint32_t> specialization; // constant_id i of both stages is specialization[i]
+};
+
+// Every pipeline the renderer uses, one per distinct PipelineState. Requesting a state that isn't known yet compiles it on the
+// pool and returns straight away, get hands out VK_NULL_HANDLE until it's done so the caller skips the draw instead of waiting.
+// A shader that changes on disk is recompiled the same way, the old pipeline stays in use until the new one is ready.
+// Main thread only, apart from the compiles themselves.
+class PipelineRegistry {
+
+private:
+	struct Entry {
+		PipelineState state;
+		uint64_t hash;
+		VkPipeline pipeline; // VK_NULL_HANDLE until the first compile is in
+		std::shared_future<VkPipeline> compile; // valid while a compile runs on the pool
+		bool compileStale; // a shader changed again while the compile was running
+	};
+
+	DLPipeline* pipeline;
+	ThreadPool* threadPool;
+	uint32_t frameCount;
+
+	std::vector<Entry> entries;
+	std::unordered_map<uint64_t, std::vector<PipelineId>> hashes; // hash of a state to the entries that have it
+
+	std::vector<std::pair<VkPipeline, uint32_t>> retiredPipelines; // replaced by a recompile, with the frames left until they're idle
+
+	static uint64_t hashState(const PipelineState& state);
+	static bool sameState(const PipelineState& a, const PipelineState& b);
+
+	// the entry for state, added if it's new. added tells which
+	PipelineId find(const PipelineState& state, bool& added);
+	void startCompile(Entry& entry);
+	// swaps in the result of entry's finished compile, or keeps the old pipeline if it threw
+	void finishCompile(Entry& entry);
+
+public:
+	PipelineRegistry(DLPipeline* pipeline, ThreadPool* threadPool, uint32_t frameCount);
+	~PipelineRegistry();
+
+	// starts compiling state on the pool if it's new. Cheap for a state that's already known
+	PipelineId request(const PipelineState& state);
+	// compiles state on the calling thread if it's new, so it's ready once this returns. For startup and loading screens.
+	// Waits if it's already compiling on the pool, so don't call it from inside a pool job then
+	PipelineId build(const PipelineState& state);
+
+	// VK_NULL_HANDLE while the pipeline is still compiling or failed to
+	VkPipeline get(PipelineId id);
+	bool isReady(PipelineId id) { return get(id) != VK_NULL_HANDLE; }
+
+	// recompiles every pipeline built from shaderPath in the background. false if none uses it
+	bool rebuild(const std::string& shaderPath);
+
+	// once per frame, after the frame's fence. Swaps in finished compiles and destroys pipelines they replaced once the
+	// frames that may still use them are done
+	void update();
+
+	uint32_t getPipelineCount() { return static_cast<uint32_t>(entries.size()); }
+
+	// waits for running compiles, then destroys every pipeline
+	void destroyPipelineRegistry();
+};
@@ -0,0 +1,931 @@
+#include "ResourceManager.h"
+#include "DLPipeline.h"
+#include "../Hash.h"
+
+const VkDeviceSize VERTEX_BUFFER_SIZE = 64ull * 1024 * 1024; // per geometry block, larger for a mesh that doesn't fit in one
+const VkDeviceSize INDEX_BUFFER_SIZE = 32ull * 1024 * 1024;
+const size_t HASH_CHUNK_SIZE = 1024 * 1024; // files larger than this are hashed a chunk per pool job
+const VkDeviceSize GEOMETRY_ALIGNMENT = 16; // covers index offsets and the constant color's r8g8b8a8 fetch
+const uint32_t MAX_MATERIALS = 1024;
+
+
+ResourceManager::ResourceManager(DLPipeline* pipeline, ThreadPool* threadPool, TextureLoader* textureLoader, VkDescriptorSetLayout descriptorSetLayout,
+    VkSampler sampler, VkBuffer uniformBuffer, VkDeviceSize uniformRange, uint32_t frameCount)
+{
+    this->pipeline = pipeline;
+    this->threadPool = threadPool;
+    this->vfs = pipeline->vfs;
+    this->textureLoader = textureLoader;
+    this->descriptorSetLayout = descriptorSetLayout;
+    this->sampler = sampler;
+    this->uniformBuffer = uniformBuffer;
+    this->uniformRange = uniformRange;
+    this->frameCount = frameCount;
+    uploadsPending = false;
+
+    createDescriptorPool();
+    createGeometryBlock(VERTEX_BUFFER_SIZE, INDEX_BUFFER_SIZE);
+}
+
+ResourceManager::~ResourceManager()
+{
+
+}
+
+void ResourceManager::createDescriptorPool()
+{
+    std::array<VkDescriptorPoolSize, 2> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSizes[0].descriptorCount = MAX_MATERIALS * frameCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[1].descriptorCount = MAX_MATERIALS * frameCount;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    // materials come and go with the scene, their sets go back to the pool one by one
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = MAX_MATERIALS * frameCount;
+
+    if (vkCreateDescriptorPool(pipeline->device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create descriptor pool!");
+    }
+}
+
+void ResourceManager::createGeometryBlock(VkDeviceSize vertexSize, VkDeviceSize indexSize)
+{
+    VkBufferUsageFlags vertexUsage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    VkBufferUsageFlags indexUsage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+
+    GeometryBlock block{};
+    block.pool = new MemoryPool(pipeline, true);
+    block.vertexBuffer = block.pool->createBuffer(vertexSize, vertexUsage);
+    block.indexBuffer = block.pool->createBuffer(indexSize, indexUsage);
+    block.pool->solidifyMemoryPool(MemoryUsage::GPU_ONLY);
+
+    // only offsets are tracked, the ranges are bound straight out of the two buffers
+    block.vertexHeap.init(vertexSize);
+    block.indexHeap.init(indexSize);
+
+    geometryBlocks.push_back(block);
+}
+
+bool ResourceManager::allocateGeometry(GeometryBlock& block, VkDeviceSize vertexSize, VkDeviceSize indexSize, uint64_t& vertexOffset,
+    uint64_t& indexOffset, uint32_t& vertexNode, uint32_t& indexNode)
+{
+    if (!block.vertexHeap.allocate(vertexSize, GEOMETRY_ALIGNMENT, vertexOffset, vertexNode))
+    {
+        return false;
+    }
+
+    if (!block.indexHeap.allocate(indexSize, GEOMETRY_ALIGNMENT, indexOffset, indexNode))
+    {
+        block.vertexHeap.free(vertexNode);
+        return false;
+    }
+
+    return true;
+}
+
+MeshHandle ResourceManager::loadMesh(const std::string& path)
+{
+    std::unordered_map<std::string, MeshHandle>::iterator loaded = meshPaths.find(path);
+
+    if (loaded != meshPaths.end())
+    {
+        meshes.get(loaded->second)->references++;
+        return loaded->second;
+    }
+
+    MappedFile file;
+    PackedMesh imported;
+    MeshView view;
+
+    readMesh(path, vfs, threadPool, file, imported, view);
+
+    MeshResource resource{};
+    resource.path = path;
+    resource.references = 1;
+    resource.data = acquireMeshData(view.hash, view);
+    resource.reloadData = SlotHandle();
+    resource.reimportStale = false;
+
+    MeshHandle handle = meshes.insert(resource);
+    meshPaths[path] = handle;
+
+    return handle;
+}
+
+void ResourceManager::readMesh(const std::string& path, VirtualFileSystem* vfs, ThreadPool* threadPool, MappedFile& file, PackedMesh& imported, MeshView& view)
+{
+    std::string cachePath = MeshCache::cachePath(path);
+
+    // a packed cache is what shipped, there's no source to compare it against
+    bool cached = vfs->isPacked(cachePath) || MappedFile::isUpToDate(path, cachePath);
+
+    if (cached && MeshCache::view(vfs->open(cachePath, file), view))
+    {
+        return;
+    }
+
+    file.close();
+
+    // first launch or the obj changed
+    importMesh(path, vfs, threadPool, imported);
+
+    try
+    {
+        MeshCache::write(cachePath, imported);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << cachePath << ": " << e.what() << std::endl;
+    }
+
+    view = MeshCache::view(imported);
+}
+
+VertexFormat ResourceManager::prepareMesh(const std::string& path, VirtualFileSystem* vfs, ThreadPool* threadPool)
+{
+    MappedFile file;
+    PackedMesh imported;
+    MeshView view;
+
+    readMesh(path, vfs, threadPool, file, imported, view);
+
+    return view.format;
+}
+
+uint64_t ResourceManager::hashMesh(const MeshView& view)
+{
+    // the packed data is deterministic, so the same geometry under another name hashes the same
+    uint64_t hash = hashBytes(&view.format, sizeof(VertexFormat));
+    hash = hashBytes(view.vertices, (size_t)view.format.stride * view.vertexCount, hash);
+    return hashBytes(view.indices, (size_t)view.format.indexSize * view.indexCount, hash);
+}
+
+uint64_t ResourceManager::hashFile(const std::string& texturePath)
+{
+    // the source if there is one, otherwise whatever was baked from it
+    MappedFile file;
+    FileView view = vfs->open(texturePath, file);
+
+    if (!view.isValid())
+    {
+        view = vfs->open(TextureBaker::bakedPath(texturePath), file);
+    }
+
+    if (view.isValid() && view.size <= HASH_CHUNK_SIZE)
+    {
+        return hashBytes(view.data, view.size);
+    }
+
+    if (view.isValid())
+    {
+        // a chunk per job and a hash over the chunks' hashes, the main thread only helps out instead of reading all of it
+        uint32_t chunkCount = static_cast<uint32_t>((view.size + HASH_CHUNK_SIZE - 1) / HASH_CHUNK_SIZE);
+        std::vector<uint64_t> chunkHashes(chunkCount);
+
+        threadPool->parallelFor(chunkCount, [&](uint32_t i)
+            {
+                size_t start = (size_t)i * HASH_CHUNK_SIZE;
+                chunkHashes[i] = hashBytes(view.data + start, std::min(HASH_CHUNK_SIZE, view.size - start));
+            });
+
+        uint64_t size = view.size;
+        uint64_t hash = hashBytes(&size, sizeof(size));
+        return hashBytes(chunkHashes.data(), chunkHashes.size() * sizeof(uint64_t), hash);
+    }
+
+    // the loader reports it, the material just keeps the placeholder
+    return hashBytes(texturePath.data(), texturePath.size());
+}
+
+void ResourceManager::importMesh(const std::string& path, VirtualFileSystem* vfs, ThreadPool* threadPool, PackedMesh& packed)
+{
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+
+    ObjImporter::import(path, vfs, threadPool, vertices, indices);
+
+    // only paid on import, the cache stores the optimized order
+    VertexCacheStats before = MeshOptimizer::analyzeVertexCache(indices, static_cast<uint32_t>(vertices.size()));
+    MeshOptimizer::optimize(vertices, indices);
+    VertexCacheStats after = MeshOptimizer::analyzeVertexCache(indices, static_cast<uint32_t>(vertices.size()));
+
+    std::cout << path << ": ACMR " << before.acmr << " -> " << after.acmr
+        << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+
+    MeshLod lods[MAX_MESH_LODS];
+    uint32_t lodCount = MeshSimplifier::buildLods(vertices, indices, lods);
+
+    for (uint32_t i = 0; i < lodCount; i++)
+    {
+        std::cout << path << ": LOD " << i << " " << lods[i].indexCount / 3 << " triangles, error " << lods[i].error << std::endl;
+    }
+
+    std::vector<Meshlet> meshlets;
+    MeshletBuilder::build(vertices, indices, lods, lodCount, meshlets);
+
+    std::cout << path << ": " << meshlets.size() << " meshlets" << std::endl;
+
+    packed = VertexPacker::pack(vertices, indices);
+    packed.lodCount = lodCount;
+    std::copy(lods, lods + lodCount, packed.lods);
+    packed.meshlets = std::move(meshlets);
+    // hashed here, on whichever thread imports, and cached with the mesh
+    packed.hash = hashMesh(MeshCache::view(packed));
+
+    std::cout << path << ": " << packed.format.stride << " byte vertices, "
+        << packed.format.indexSize << " byte indices" << std::endl;
+}
+
+SlotHandle ResourceManager::acquireMeshData(uint64_t hash, const MeshView& view)
+{
+    std::unordered_map<uint64_t, SlotHandle>::iterator duplicate = meshHashes.find(hash);
+
+    if (duplicate != meshHashes.end())
+    {
+        meshData.get(duplicate->second)->users++;
+        return duplicate->second;
+    }
+
+    MeshData data{};
+    data.hash = hash;
+    data.users = 1;
+    data.vertexNode = TLSFHeap::INVALID_NODE;
+    data.indexNode = TLSFHeap::INVALID_NODE;
+
+    uploadMesh(data, view);
+
+    SlotHandle handle = meshData.insert(data);
+    meshHashes[hash] = handle;
+
+    return handle;
+}
+
+void ResourceManager::releaseMeshData(SlotHandle handle)
+{
+    MeshData* data = meshData.get(handle);
+
+    if (data == nullptr || --data->users > 0)
+    {
+        return;
+    }
+
+    meshHashes.erase(data->hash);
+
+    // frames already submitted may still draw from the ranges
+    DeadMesh dead{};
+    dead.block = data->block;
+    dead.vertexNode = data->vertexNode;
+    dead.indexNode = data->indexNode;
+    dead.framesLeft = frameCount;
+    deadMeshes.push_back(dead);
+
+    meshData.remove(handle);
+}
+
+void ResourceManager::uploadMesh(MeshData& data, const MeshView& view)
+{
+    VkDeviceSize vertexSize = (VkDeviceSize)view.format.stride * view.vertexCount;
+    VkDeviceSize colorOffset = ((vertexSize + 3) / 4) * 4;
+    VkDeviceSize indexSize = (VkDeviceSize)view.format.indexSize * view.indexCount;
+
+    VkDeviceSize vertexAllocationSize = colorOffset + sizeof(uint32_t);
+
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint32_t vertexNode;
+    uint32_t indexNode;
+    uint32_t blockIndex = 0;
+
+    while (blockIndex < geometryBlocks.size()
+        && !allocateGeometry(geometryBlocks[blockIndex], vertexAllocationSize, indexSize, vertexOffset, indexOffset, vertexNode, indexNode))
+    {
+        blockIndex++;
+    }
+
+    // every block is too full, a mesh larger than the usual block size gets one of its own size
+    if (blockIndex == geometryBlocks.size())
+    {
+        createGeometryBlock(std::max(VERTEX_BUFFER_SIZE, vertexAllocationSize), std::max(INDEX_BUFFER_SIZE, indexSize));
+
+        if (!allocateGeometry(geometryBlocks[blockIndex], vertexAllocationSize, indexSize, vertexOffset, indexOffset, vertexNode, indexNode))
+        {
+            throw std::runtime_error("failed to allocate mesh geometry!");
+        }
+
+        std::cout << "geometry block " << blockIndex << " added" << std::endl;
+    }
+
+    GeometryBlock& block = geometryBlocks[blockIndex];
+
+    try
+    {
+        uploadGeometry(block, block.vertexBuffer, vertexOffset, view.vertices, vertexSize);
+        uploadGeometry(block, block.vertexBuffer, vertexOffset + colorOffset, &view.format.constantColor, sizeof(uint32_t));
+        uploadGeometry(block, block.indexBuffer, indexOffset, view.indices, indexSize);
+    }
+    catch (const std::exception&)
+    {
+        // copies already recorded into the ranges run before anything recorded for their next owner
+        block.vertexHeap.free(vertexNode);
+        block.indexHeap.free(indexNode);
+        throw;
+    }
+
+    data.block = blockIndex;
+    data.vertexNode = vertexNode;
+    data.indexNode = indexNode;
+    data.uploadValue = pipeline->uploadContext->getRecordedValue();
+    data.uploaded = false;
+
+    // both buffers are ranges of the pool's one backing buffer, the offsets are bound against that
+    MPBuffer* vertexBuffer = block.pool->getBuffer(block.vertexBuffer);
+    MPBuffer* indexBuffer = block.pool->getBuffer(block.indexBuffer);
+
+    GpuMesh& mesh = data.mesh;
+    mesh.format = view.format;
+    mesh.vertexBuffer = vertexBuffer->buffer;
+    mesh.indexBuffer = indexBuffer->buffer;
+    mesh.vertexOffset = vertexBuffer->offset + vertexOffset;
+    mesh.colorOffset = mesh.vertexOffset + colorOffset;
+    mesh.indexOffset = indexBuffer->offset + indexOffset;
+    mesh.vertexCount = view.vertexCount;
+    mesh.indexCount = view.indexCount;
+    mesh.boundsMin = view.boundsMin;
+    mesh.boundsMax = view.boundsMax;
+    mesh.lodCount = view.lodCount;
+    std::copy(view.lods, view.lods + view.lodCount, mesh.lods);
+
+    // culling reads the meshlets every frame, they get their own copy
+    mesh.meshlets.assign(view.meshlets, view.meshlets + view.meshletCount);
+}
+
+void ResourceManager::uploadGeometry(GeometryBlock& block, MPHandle handle, VkDeviceSize offset, const void* data, VkDeviceSize size)
+{
+    MPBuffer* buffer = block.pool->getBuffer(handle);
+
+    // on unified memory the pool is mapped, nothing reads a range before it's handed out so it's written in place
+    if (buffer->allocation.mappedData != nullptr)
+    {
+        memcpy((unsigned char*)buffer->allocation.mappedData + offset, data, (size_t)size);
+        return;
+    }
+
+    // a mesh larger than the ring goes through it in pieces, allocating one may flush the pieces before it
+    VkDeviceSize chunkSize = pipeline->stagingRing->getChunkSize();
+
+    for (VkDeviceSize start = 0; start < size; start += chunkSize)
+    {
+        VkDeviceSize pieceSize = std::min(chunkSize, size - start);
+
+        StagingRegion staging = pipeline->stagingRing->allocate(pieceSize);
+        memcpy(staging.data, (const unsigned char*)data + start, (size_t)pieceSize);
+
+        // on the transfer queue when there is one, as one more region of the batch's copy into this block. The range is new,
+        // so only it changes hands, the meshes being drawn out of the rest of the buffer aren't touched
+        VkBufferCopy copyRegion{};
+        copyRegion.srcOffset = staging.offset;
+        copyRegion.dstOffset = buffer->offset + offset + start;
+        copyRegion.size = pieceSize;
+        pipeline->uploadContext->copyBuffer(staging.buffer, buffer->buffer, copyRegion);
+
+        pipeline->uploadContext->releaseBuffer(buffer->buffer, buffer->offset + offset + start, pieceSize);
+    }
+
+    uploadsPending = true;
+}
+
+MaterialHandle ResourceManager::loadMaterial(const std::string& texturePath)
+{
+    std::unordered_map<std::string, MaterialHandle>::iterator loaded = materialPaths.find(texturePath);
+
+    if (loaded != materialPaths.end())
+    {
+        materials.get(loaded->second)->references++;
+        return loaded->second;
+    }
+
+    uint64_t hash = hashFile(texturePath);
+    std::unordered_map<uint64_t, SlotHandle>::iterator duplicate = materialHashes.find(hash);
+
+    MaterialResource material{};
+    material.path = texturePath;
+    material.references = 1;
+    material.reloadTexture = TextureHandle();
+    material.reloadHash = 0;
+
+    // the same contents under another name don't get decoded again
+    if (duplicate != materialHashes.end())
+    {
+        materialData.get(duplicate->second)->users++;
+        material.data = duplicate->second;
+    }
+    else
+    {
+        material.data = acquireMaterialData(hash, textureLoader->load(texturePath));
+    }
+
+    MaterialHandle handle = materials.insert(material);
+    materialPaths[texturePath] = handle;
+
+    return handle;
+}
+
+SlotHandle ResourceManager::acquireMaterialData(uint64_t hash, TextureHandle texture)
+{
+    std::unordered_map<uint64_t, SlotHandle>::iterator duplicate = materialHashes.find(hash);
+
+    if (duplicate != materialHashes.end())
+    {
+        textureLoader->unload(texture);
+        materialData.get(duplicate->second)->users++;
+        return duplicate->second;
+    }
+
+    MaterialData data{};
+    data.hash = hash;
+    data.users = 1;
+    data.texture = texture;
+
+    allocateDescriptorSets(data);
+
+    SlotHandle handle = materialData.insert(data);
+    materialHashes[hash] = handle;
+
+    return handle;
+}
+
+void ResourceManager::releaseMaterialData(SlotHandle handle)
+{
+    MaterialData* data = materialData.get(handle);
+
+    if (data == nullptr || --data->users > 0)
+    {
+        return;
+    }
+
+    materialHashes.erase(data->hash);
+
+    // frames already submitted may still bind the sets
+    DeadMaterial dead{};
+    dead.texture = data->texture;
+    dead.descriptorSets = data->descriptorSets;
+    dead.framesLeft = frameCount;
+    deadMaterials.push_back(dead);
+
+    materialData.remove(handle);
+}
+
+void ResourceManager::allocateDescriptorSets(MaterialData& material)
+{
+    std::vector<VkDescriptorSetLayout> layouts(frameCount, descriptorSetLayout);
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = frameCount;
+    allocInfo.pSetLayouts = layouts.data();
+
+    material.descriptorSets.resize(frameCount);
+    material.boundViews.resize(frameCount);
+
+    if (vkAllocateDescriptorSets(pipeline->device, &allocInfo, material.descriptorSets.data()) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to allocate descriptor sets!");
+    }
+
+    for (uint32_t i = 0; i < frameCount; i++)
+    {
+        VkDescriptorBufferInfo bufferInfo{};
+        // the offset into the arena is given when the set is bound
+        bufferInfo.buffer = uniformBuffer;
+        bufferInfo.offset = 0;
+        bufferInfo.range = uniformRange;
+
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = material.descriptorSets[i];
+        descriptorWrite.dstBinding = 0;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pBufferInfo = &bufferInfo;
+
+        vkUpdateDescriptorSets(pipeline->device, 1, &descriptorWrite, 0, nullptr);
+
+        // nothing uses the new sets yet, so every frame's can be written now
+        material.boundViews[i] = VK_NULL_HANDLE;
+        writeDescriptorSet(material, i);
+    }
+}
+
+void ResourceManager::writeDescriptorSet(MaterialData& material, uint32_t frame)
+{
+    VkImageView view = textureLoader->getView(material.texture);
+
+    if (material.boundViews[frame] == view)
+    {
+        return;
+    }
+
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.imageView = view;
+    imageInfo.sampler = sampler;
+
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = material.descriptorSets[frame];
+    descriptorWrite.dstBinding = 1;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+
+    vkUpdateDescriptorSets(pipeline->device, 1, &descriptorWrite, 0, nullptr);
+
+    material.boundViews[frame] = view;
+}
+
+void ResourceManager::releaseMesh(MeshHandle handle)
+{
+    MeshResource* mesh = meshes.get(handle);
+
+    if (mesh == nullptr || --mesh->references > 0)
+    {
+        return;
+    }
+
+    meshPaths.erase(mesh->path);
+    releaseMeshData(mesh->data);
+    releaseMeshData(mesh->reloadData);
+
+    meshes.remove(handle);
+}
+
+void ResourceManager::releaseMaterial(MaterialHandle handle)
+{
+    MaterialResource* material = materials.get(handle);
+
+    if (material == nullptr || --material->references > 0)
+    {
+        return;
+    }
+
+    materialPaths.erase(material->path);
+    releaseMaterialData(material->data);
+
+    // never bound, it can go right away
+    textureLoader->unload(material->reloadTexture);
+
+    materials.remove(handle);
+}
+
+bool ResourceManager::reload(const std::string& path)
+{
+    std::unordered_map<std::string, MeshHandle>::iterator mesh = meshPaths.find(path);
+
+    if (mesh != meshPaths.end())
+    {
+        MeshResource* resource = meshes.get(mesh->second);
+
+        // importing twice at once would race on writing the cache, run it again once this one is done
+        if (resource->reimport.valid())
+        {
+            resource->reimportStale = true;
+        }
+        else
+        {
+            reimportMesh(*resource);
+        }
+
+        return true;
+    }
+
+    std::unordered_map<std::string, MaterialHandle>::iterator material = materialPaths.find(path);
+
+    if (material != materialPaths.end())
+    {
+        reloadMaterial(*materials.get(material->second));
+        return true;
+    }
+
+    return false;
+}
+
+void ResourceManager::reimportMesh(MeshResource& mesh)
+{
+    mesh.reimportStale = false;
+
+    std::string path = mesh.path;
+
+    // its own thread rather than a pool job, so a long import doesn't hold up the texture decodes queued behind it
+    mesh.reimport = std::async(std::launch::async, [this, path]()
+        {
+            PackedMesh packed;
+            importMesh(path, vfs, threadPool, packed);
+
+            std::string cachePath = MeshCache::cachePath(path);
+
+            try
+            {
+                MeshCache::write(cachePath, packed);
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << cachePath << ": " << e.what() << std::endl;
+            }
+
+            return packed;
+        }).share();
+}
+
+void ResourceManager::reloadMaterial(MaterialResource& material)
+{
+    // the older change never got bound, only the latest one matters
+    textureLoader->unload(material.reloadTexture);
+    material.reloadTexture = TextureHandle();
+
+    uint64_t hash = hashFile(material.path);
+
+    // saved without changes
+    if (hash == materialData.get(material.data)->hash)
+    {
+        return;
+    }
+
+    std::unordered_map<uint64_t, SlotHandle>::iterator duplicate = materialHashes.find(hash);
+
+    // it now matches something already loaded, switch over without decoding anything
+    if (duplicate != materialHashes.end())
+    {
+        materialData.get(duplicate->second)->users++;
+        releaseMaterialData(material.data);
+        material.data = duplicate->second;
+
+        std::cout << material.path << ": reloaded" << std::endl;
+        return;
+    }
+
+    // the loader sees the source is newer than the baked file and bakes it again
+    material.reloadTexture = textureLoader->load(material.path);
+    material.reloadHash = hash;
+}
+
+void ResourceManager::completeReloads()
+{
+    for (uint32_t i = 0; i < meshes.size(); i++)
+    {
+        MeshResource& mesh = meshes[i];
+
+        if (!mesh.reimport.valid() || mesh.reimport.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            continue;
+        }
+
+        std::shared_future<PackedMesh> reimport = mesh.reimport;
+        mesh.reimport = std::shared_future<PackedMesh>();
+
+        if (mesh.reimportStale)
+        {
+            reimportMesh(mesh);
+            continue;
+        }
+
+        try
+        {
+            const PackedMesh& packed = reimport.get();
+            MeshView view = MeshCache::view(packed);
+
+            // an earlier reload still uploading is replaced, what's drawn stays until this one is in
+            releaseMeshData(mesh.reloadData);
+            mesh.reloadData = SlotHandle();
+
+            if (view.hash == meshData.get(mesh.data)->hash)
+            {
+                continue;
+            }
+
+            // only this path moves to the new contents, others that shared the old ones keep them. update swaps it in once
+            // the copies are done
+            mesh.reloadData = acquireMeshData(view.hash, view);
+        }
+        catch (const std::exception& e)
+        {
+            // a half saved or broken file, keep drawing what was there
+            std::cerr << mesh.path << ": " << e.what() << std::endl;
+        }
+    }
+
+    for (uint32_t i = 0; i < materials.size(); i++)
+    {
+        MaterialResource& material = materials[i];
+
+        if (material.reloadTexture.isNull())
+        {
+            continue;
+        }
+
+        TextureState state = textureLoader->getState(material.reloadTexture);
+
+        if (state == TextureState::FAILED)
+        {
+            textureLoader->unload(material.reloadTexture);
+            material.reloadTexture = TextureHandle();
+        }
+        else if (state == TextureState::RESIDENT)
+        {
+            // new sets for the new texture, the old ones stay with whoever else uses them or go once their frames are done
+            SlotHandle previous = material.data;
+            material.data = acquireMaterialData(material.reloadHash, material.reloadTexture);
+            material.reloadTexture = TextureHandle();
+            releaseMaterialData(previous);
+
+            std::cout << material.path << ": reloaded" << std::endl;
+        }
+    }
+}
+
+void ResourceManager::update(uint32_t frame)
+{
+    textureLoader->update();
+
+    completeReloads();
+
+    // every mesh loaded since the last frame goes out in one submission, frames keep drawing without them meanwhile
+    if (uploadsPending)
+    {
+        pipeline->flushSetupCommands();
+        uploadsPending = false;
+    }
+
+    for (uint32_t i = 0; i < meshData.size(); i++)
+    {
+        if (!meshData[i].uploaded && pipeline->uploadContext->isComplete(meshData[i].uploadValue))
+        {
+            meshData[i].uploaded = true;
+        }
+    }
+
+    for (uint32_t i = 0; i < meshes.size(); i++)
+    {
+        MeshResource& mesh = meshes[i];
+
+        if (mesh.reloadData.isNull() || !meshData.get(mesh.reloadData)->uploaded)
+        {
+            continue;
+        }
+
+        // frames in flight keep drawing the old ranges, the ones recorded from now on use the new ones
+        releaseMeshData(mesh.data);
+        mesh.data = mesh.reloadData;
+        mesh.reloadData = SlotHandle();
+
+        std::cout << mesh.path << ": reloaded" << std::endl;
+    }
+
+    retire();
+
+    // this frame's sets are idle now, point them at textures that became resident
+    for (uint32_t i = 0; i < materialData.size(); i++)
+    {
+        writeDescriptorSet(materialData[i], frame);
+    }
+}
+
+void ResourceManager::retire()
+{
+    for (size_t i = 0; i < deadMeshes.size();)
+    {
+        if (--deadMeshes[i].framesLeft > 0)
+        {
+            i++;
+            continue;
+        }
+
+        GeometryBlock& block = geometryBlocks[deadMeshes[i].block];
+        block.vertexHeap.free(deadMeshes[i].vertexNode);
+        block.indexHeap.free(deadMeshes[i].indexNode);
+
+        deadMeshes[i] = deadMeshes.back();
+        deadMeshes.pop_back();
+    }
+
+    for (size_t i = 0; i < deadMaterials.size();)
+    {
+        if (--deadMaterials[i].framesLeft > 0)
+        {
+            i++;
+            continue;
+        }
+
+        textureLoader->unload(deadMaterials[i].texture);
+
+        vkFreeDescriptorSets(pipeline->device, descriptorPool, static_cast<uint32_t>(deadMaterials[i].descriptorSets.size()),
+            deadMaterials[i].descriptorSets.data());
+
+        deadMaterials[i] = deadMaterials.back();
+        deadMaterials.pop_back();
+    }
+}
+
+const GpuMesh* ResourceManager::getMesh(MeshHandle handle)
+{
+    MeshResource* mesh = meshes.get(handle);
+
+    if (mesh == nullptr)
+    {
+        return nullptr;
+    }
+
+    return &meshData.get(mesh->data)->mesh;
+}
+
+bool ResourceManager::isMeshReady(MeshHandle handle)
+{
+    MeshResource* mesh = meshes.get(handle);
+
+    return mesh != nullptr && meshData.get(mesh->data)->uploaded;
+}
+
+VkDescriptorSet ResourceManager::getDescriptorSet(MaterialHandle handle, uint32_t frame)
+{
+    MaterialResource* material = materials.get(handle);
+
+    if (material == nullptr)
+    {
+        return VK_NULL_HANDLE;
+    }
+
+    return materialData.get(material->data)->descriptorSets[frame];
+}
+
+VkDeviceSize ResourceManager::getFreeVertexSize()
+{
+    VkDeviceSize freeSize = 0;
+
+    for (const GeometryBlock& block : geometryBlocks)
+    {
+        freeSize += block.vertexHeap.getFreeSize();
+    }
+
+    return freeSize;
+}
+
+VkDeviceSize ResourceManager::getFreeIndexSize()
+{
+    VkDeviceSize freeSize = 0;
+
+    for (const GeometryBlock& block : geometryBlocks)
+    {
+        freeSize += block.indexHeap.getFreeSize();
+    }
+
+    return freeSize;
+}
+
+void ResourceManager::destroyResourceManager()
+{
+    // only called once the device is idle, nothing is in flight anymore
+    for (uint32_t i = 0; i < materialData.size(); i++)
+    {
+        textureLoader->unload(materialData[i].texture);
+    }
+
+    for (uint32_t i = 0; i < materials.size(); i++)
+    {
+        textureLoader->unload(materials[i].reloadTexture);
+    }
+
+    // a running reimport still uses the pool, clearing the meshes waits for it
+
+    for (const DeadMaterial& dead : deadMaterials)
+    {
+        textureLoader->unload(dead.texture);
+    }
+
+    materials.clear();
+    materialData.clear();
+    meshes.clear();
+    meshData.clear();
+    deadMaterials.clear();
+    deadMeshes.clear();
+    meshPaths.clear();
+    meshHashes.clear();
+    materialPaths.clear();
+    materialHashes.clear();
+
+    vkDestroyDescriptorPool(pipeline->device, descriptorPool, nullptr);
+
+    for (GeometryBlock& block : geometryBlocks)
+    {
+        block.pool->destroyMemoryPool();
+        delete block.pool;
+    }
+    geometryBlocks.clear();
+}
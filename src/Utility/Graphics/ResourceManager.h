@@ -0,0 +1,215 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdexcept>
+#include <future>
+
+#include "MemoryPool.h"
+#include "TLSFHeap.h"
+#include "SlotMap.h"
+#include "TextureLoader.h"
+#include "MeshCache.h"
+#include "../ThreadPool.h"
+#include "../MappedFile.h"
+#include "../VirtualFileSystem.h"
+
+class DLPipeline;
+
+typedef SlotHandle MeshHandle;
+// a texture together with the descriptor sets that bind it
+typedef SlotHandle MaterialHandle;
+
+// A mesh's ranges of the shared vertex and index buffers, and what the cpu needs to pick a lod and cull it.
+struct GpuMesh {
+	VertexFormat format;
+	VkBuffer vertexBuffer;
+	VkBuffer indexBuffer;
+	VkDeviceSize vertexOffset; // into vertexBuffer
+	VkDeviceSize colorOffset; // the constant color, right after the vertices
+	VkDeviceSize indexOffset; // into indexBuffer
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	Vector3 boundsMin;
+	Vector3 boundsMax;
+	MeshLod lods[MAX_MESH_LODS];
+	uint32_t lodCount;
+	std::vector<Meshlet> meshlets;
+};
+
+// Owns every mesh and texture the scene uses. Geometry of all meshes is sub allocated out of a few large vertex and index
+// buffers, so loading a mesh is a copy into a free range instead of new buffers and memory. Another pair of buffers is added
+// once the existing ones are too full for a mesh.
+// Resources are reference counted: loading a path that's already loaded hands back the existing handle. A handle is one
+// path, what's on the gpu is shared by content, so a different path with the same contents costs no new geometry or texture.
+// Once nothing refers to the data anymore it lives on until the frames in flight that may still draw it are done.
+class ResourceManager {
+
+private:
+	// geometry in the shared buffers, one per distinct content
+	struct MeshData {
+		uint64_t hash;
+		uint32_t users; // MeshResources pointing at it
+		GpuMesh mesh;
+		uint32_t block; // index into geometryBlocks
+		uint32_t vertexNode;
+		uint32_t indexNode;
+		uint64_t uploadValue; // upload context value the geometry copies reach
+		bool uploaded; // drawn from the frame after the copies are done, set by update
+	};
+
+	// one per loaded path, what a MeshHandle refers to
+	struct MeshResource {
+		std::string path;
+		uint32_t references;
+		SlotHandle data; // into meshData
+		SlotHandle reloadData; // a reload's contents while they're uploaded, data is drawn until they're in
+		std::shared_future<PackedMesh> reimport; // valid while a changed source is imported in the background
+		bool reimportStale; // the source changed again while the import was running
+	};
+
+	// a texture and the descriptor sets that bind it, one per distinct content
+	struct MaterialData {
+		uint64_t hash;
+		uint32_t users; // MaterialResources pointing at it
+		TextureHandle texture;
+		std::vector<VkDescriptorSet> descriptorSets; // one per frame in flight
+		std::vector<VkImageView> boundViews; // what each set points at, the placeholder until the texture is in
+	};
+
+	// one per loaded path, what a MaterialHandle refers to
+	struct MaterialResource {
+		std::string path;
+		uint32_t references;
+		SlotHandle data; // into materialData
+		TextureHandle reloadTexture; // a changed file on its way in, the old data stays bound until it's resident
+		uint64_t reloadHash;
+	};
+
+	struct DeadMesh {
+		uint32_t block;
+		uint32_t vertexNode;
+		uint32_t indexNode;
+		uint32_t framesLeft;
+	};
+
+	// one vertex and one index buffer, both ranges of the same packed pool
+	struct GeometryBlock {
+		MemoryPool* pool;
+		MPHandle vertexBuffer;
+		MPHandle indexBuffer;
+		TLSFHeap vertexHeap;
+		TLSFHeap indexHeap;
+	};
+
+	struct DeadMaterial {
+		TextureHandle texture;
+		std::vector<VkDescriptorSet> descriptorSets;
+		uint32_t framesLeft;
+	};
+
+	DLPipeline* pipeline;
+	ThreadPool* threadPool;
+	VirtualFileSystem* vfs;
+	TextureLoader* textureLoader;
+
+	VkDescriptorSetLayout descriptorSetLayout;
+	VkSampler sampler;
+	VkBuffer uniformBuffer;
+	VkDeviceSize uniformRange;
+	uint32_t frameCount;
+	VkDescriptorPool descriptorPool;
+
+	std::vector<GeometryBlock> geometryBlocks;
+
+	SlotMap<MeshResource> meshes;
+	SlotMap<MeshData> meshData;
+	SlotMap<MaterialResource> materials;
+	SlotMap<MaterialData> materialData;
+	std::unordered_map<std::string, MeshHandle> meshPaths;
+	std::unordered_map<uint64_t, SlotHandle> meshHashes;
+	std::unordered_map<std::string, MaterialHandle> materialPaths;
+	std::unordered_map<uint64_t, SlotHandle> materialHashes;
+
+	std::vector<DeadMesh> deadMeshes;
+	std::vector<DeadMaterial> deadMaterials;
+
+	bool uploadsPending;
+
+	void createDescriptorPool();
+	void createGeometryBlock(VkDeviceSize vertexSize, VkDeviceSize indexSize);
+	bool allocateGeometry(GeometryBlock& block, VkDeviceSize vertexSize, VkDeviceSize indexSize, uint64_t& vertexOffset, uint64_t& indexOffset,
+		uint32_t& vertexNode, uint32_t& indexNode);
+
+	static uint64_t hashMesh(const MeshView& view);
+	uint64_t hashFile(const std::string& texturePath);
+
+	static void importMesh(const std::string& path, VirtualFileSystem* vfs, ThreadPool* threadPool, PackedMesh& packed);
+	// the cache mapped into file if it's current, otherwise the obj imported into imported and the cache written for next time
+	static void readMesh(const std::string& path, VirtualFileSystem* vfs, ThreadPool* threadPool, MappedFile& file, PackedMesh& imported,
+		MeshView& view);
+	// the data already holding these contents with one more user, or new data uploaded from view
+	SlotHandle acquireMeshData(uint64_t hash, const MeshView& view);
+	void releaseMeshData(SlotHandle handle);
+	// ranges for view's data, in a new block if none of the existing ones has room
+	void uploadMesh(MeshData& data, const MeshView& view);
+	void uploadGeometry(GeometryBlock& block, MPHandle handle, VkDeviceSize offset, const void* data, VkDeviceSize size);
+
+	// takes over texture, or unloads it if the contents are already loaded
+	SlotHandle acquireMaterialData(uint64_t hash, TextureHandle texture);
+	void releaseMaterialData(SlotHandle handle);
+	void allocateDescriptorSets(MaterialData& material);
+	void writeDescriptorSet(MaterialData& material, uint32_t frame);
+
+	void reimportMesh(MeshResource& mesh);
+	void reloadMaterial(MaterialResource& material);
+	// swaps in whatever finished reloading
+	void completeReloads();
+
+	void retire();
+
+public:
+	ResourceManager(DLPipeline* pipeline, ThreadPool* threadPool, TextureLoader* textureLoader, VkDescriptorSetLayout descriptorSetLayout,
+		VkSampler sampler, VkBuffer uniformBuffer, VkDeviceSize uniformRange, uint32_t frameCount);
+	~ResourceManager();
+
+	// reads the mesh cache (importing the obj if it's stale) and records the copy into the shared buffers
+	MeshHandle loadMesh(const std::string& path);
+	// brings the mesh cache up to date without a device, so the import can run on a worker while Vulkan is still being set up.
+	// loadMesh then only maps the cache. Returns the format the mesh will be drawn with
+	static VertexFormat prepareMesh(const std::string& path, VirtualFileSystem* vfs, ThreadPool* threadPool);
+	// starts decoding on the pool, the material binds the placeholder until the texture is resident
+	MaterialHandle loadMaterial(const std::string& texturePath);
+
+	void releaseMesh(MeshHandle handle);
+	void releaseMaterial(MaterialHandle handle);
+
+	// path changed on disk. If it's a loaded mesh or texture it's imported again in the background and swapped in by a later
+	// update, handles stay the same. Only path's handle changes, other paths that had the same contents keep theirs.
+	// false if nothing loaded came from path
+	bool reload(const std::string& path);
+
+	// once per frame, after the frame's fence. Swaps in finished reloads, submits the geometry copies recorded since the last
+	// call, marks meshes whose copies are done as ready, frees what was released long enough ago and points frame's descriptor sets at textures that became resident
+	void update(uint32_t frame);
+
+	// nullptr for released meshes. Only good until the next loadMesh or releaseMesh
+	const GpuMesh* getMesh(MeshHandle handle);
+	// false until the geometry of a newly loaded mesh has been uploaded, the model isn't drawn before that
+	bool isMeshReady(MeshHandle handle);
+	VkDescriptorSet getDescriptorSet(MaterialHandle handle, uint32_t frame);
+
+	// distinct contents, a file loaded under two paths counts once
+	uint32_t getMeshCount() { return meshData.size(); }
+	uint32_t getMaterialCount() { return materialData.size(); }
+	uint32_t getGeometryBlockCount() { return static_cast<uint32_t>(geometryBlocks.size()); }
+	VkDeviceSize getFreeVertexSize();
+	VkDeviceSize getFreeIndexSize();
+
+	void destroyResourceManager();
+};
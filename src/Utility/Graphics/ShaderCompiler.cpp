@@ -0,0 +1,249 @@
+#include "ShaderCompiler.h"
+#include "../Hash.h"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <sstream>
+#include <thread>
+#include <functional>
+#include <cstring>
+
+#ifdef DL_SHADER_COMPILER
+#include <shaderc/shaderc.h>
+#endif
+
+const uint32_t SHADER_CACHE_VERSION = 1; // bump when the compile options change, every cached variant is then stale
+
+const uint32_t SPIRV_MAGIC = 0x07230203;
+const uint32_t SPIRV_HEADER_WORDS = 5;
+
+// debug instructions, nothing else refers to them
+const uint16_t SPIRV_OP_SOURCE_CONTINUED = 2;
+const uint16_t SPIRV_OP_SOURCE = 3;
+const uint16_t SPIRV_OP_SOURCE_EXTENSION = 4;
+const uint16_t SPIRV_OP_NAME = 5;
+const uint16_t SPIRV_OP_MEMBER_NAME = 6;
+const uint16_t SPIRV_OP_STRING = 7;
+const uint16_t SPIRV_OP_LINE = 8;
+const uint16_t SPIRV_OP_NO_LINE = 317;
+const uint16_t SPIRV_OP_MODULE_PROCESSED = 330;
+
+
+ShaderCompiler::ShaderCompiler(VirtualFileSystem* vfs, const std::string& cacheDirectory)
+{
+    this->vfs = vfs;
+    this->cacheDirectory = cacheDirectory;
+}
+
+ShaderCompiler::~ShaderCompiler()
+{
+
+}
+
+uint64_t ShaderCompiler::hashVariant(FileView source, const std::string& path, const std::vector<std::string>& defines)
+{
+    uint64_t hash = hashBytes(&SHADER_CACHE_VERSION, sizeof(SHADER_CACHE_VERSION));
+    hash = hashBytes(source.data, source.size, hash);
+
+    // the extension picks the stage
+    std::string extension = std::filesystem::path(path).extension().string();
+    hash = hashBytes(extension.data(), extension.size(), hash);
+
+    for (const std::string& define : defines)
+    {
+        // the terminator keeps {"AB"} and {"A", "B"} apart
+        hash = hashBytes(define.c_str(), define.size() + 1, hash);
+    }
+
+    return hash;
+}
+
+FileView ShaderCompiler::load(const std::string& path, const std::vector<std::string>& defines, MappedFile& cacheFile, std::vector<uint32_t>& compiled)
+{
+    if (std::filesystem::path(path).extension() == ".spv")
+    {
+        return vfs->open(path, cacheFile);
+    }
+
+    MappedFile sourceFile;
+    FileView source = vfs->open(path, sourceFile);
+
+    if (!source.isValid())
+    {
+        throw std::runtime_error("failed to open " + path + "!");
+    }
+
+    std::stringstream name;
+    name << std::filesystem::path(path).filename().string() << "." << std::hex << hashVariant(source, path, defines) << ".spv";
+    std::string cachePath = cacheDirectory + "/" + name.str();
+
+    // the name is the hash, so a cache file that exists is current
+    FileView cached = vfs->open(cachePath, cacheFile);
+
+    if (cached.isValid())
+    {
+        return cached;
+    }
+
+#ifdef DL_SHADER_COMPILER
+    compile(source, path, defines, compiled);
+    strip(compiled);
+
+    // not being able to cache it only costs the next launch
+    try
+    {
+        writeCache(cachePath, compiled);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << cachePath << ": " << e.what() << std::endl;
+    }
+
+    FileView view;
+    view.data = (const unsigned char*)compiled.data();
+    view.size = compiled.size() * sizeof(uint32_t);
+    return view;
+#else
+    // what hello_triangle_compile.bat builds
+    std::string prebuiltPath = std::filesystem::path(path).replace_extension(".spv").string();
+    FileView prebuilt = defines.empty() ? vfs->open(prebuiltPath, cacheFile) : FileView();
+
+    if (!prebuilt.isValid())
+    {
+        throw std::runtime_error("failed to compile " + path + ", built without DL_SHADER_COMPILER!");
+    }
+
+    return prebuilt;
+#endif
+}
+
+void ShaderCompiler::compile(FileView source, const std::string& path, const std::vector<std::string>& defines, std::vector<uint32_t>& spirv)
+{
+#ifdef DL_SHADER_COMPILER
+    std::string extension = std::filesystem::path(path).extension().string();
+    shaderc_shader_kind kind;
+
+    if (extension == ".vert")
+    {
+        kind = shaderc_vertex_shader;
+    }
+    else if (extension == ".frag")
+    {
+        kind = shaderc_fragment_shader;
+    }
+    else if (extension == ".comp")
+    {
+        kind = shaderc_compute_shader;
+    }
+    else
+    {
+        throw std::runtime_error("failed to compile " + path + ", unknown shader stage!");
+    }
+
+    // a compiler per call rather than a shared one, so any number of pipelines can compile at once
+    shaderc_compiler_t compiler = shaderc_compiler_initialize();
+    shaderc_compile_options_t options = shaderc_compile_options_initialize();
+
+    shaderc_compile_options_set_target_env(options, shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
+    shaderc_compile_options_set_optimization_level(options, shaderc_optimization_level_performance);
+
+    for (const std::string& define : defines)
+    {
+        size_t equals = define.find('=');
+        std::string value = equals == std::string::npos ? "" : define.substr(equals + 1);
+        std::string macro = define.substr(0, equals);
+
+        shaderc_compile_options_add_macro_definition(options, macro.data(), macro.size(), value.data(), value.size());
+    }
+
+    shaderc_compilation_result_t result = shaderc_compile_into_spv(compiler, (const char*)source.data, source.size, kind, path.c_str(),
+        "main", options);
+
+    bool succeeded = shaderc_result_get_compilation_status(result) == shaderc_compilation_status_success;
+    std::string errors = shaderc_result_get_error_message(result);
+
+    if (succeeded)
+    {
+        spirv.resize(shaderc_result_get_length(result) / sizeof(uint32_t));
+        memcpy(spirv.data(), shaderc_result_get_bytes(result), spirv.size() * sizeof(uint32_t));
+    }
+
+    shaderc_result_release(result);
+    shaderc_compile_options_release(options);
+    shaderc_compiler_release(compiler);
+
+    if (!succeeded)
+    {
+        throw std::runtime_error("failed to compile " + path + "!\n" + errors);
+    }
+#else
+    throw std::runtime_error("failed to compile " + path + ", built without DL_SHADER_COMPILER!");
+#endif
+}
+
+void ShaderCompiler::strip(std::vector<uint32_t>& spirv)
+{
+    if (spirv.size() < SPIRV_HEADER_WORDS || spirv[0] != SPIRV_MAGIC)
+    {
+        return;
+    }
+
+    size_t write = SPIRV_HEADER_WORDS;
+
+    for (size_t read = SPIRV_HEADER_WORDS; read < spirv.size();)
+    {
+        // each instruction's first word is its word count in the high half and its opcode in the low half
+        uint32_t wordCount = spirv[read] >> 16;
+        uint16_t opcode = static_cast<uint16_t>(spirv[read] & 0xFFFF);
+
+        // malformed, the rest is kept as it is for the driver to reject
+        if (wordCount == 0 || read + wordCount > spirv.size())
+        {
+            std::copy(spirv.begin() + read, spirv.end(), spirv.begin() + write);
+            write += spirv.size() - read;
+            break;
+        }
+
+        bool debug = opcode == SPIRV_OP_SOURCE_CONTINUED || opcode == SPIRV_OP_SOURCE || opcode == SPIRV_OP_SOURCE_EXTENSION
+            || opcode == SPIRV_OP_NAME || opcode == SPIRV_OP_MEMBER_NAME || opcode == SPIRV_OP_STRING || opcode == SPIRV_OP_LINE
+            || opcode == SPIRV_OP_NO_LINE || opcode == SPIRV_OP_MODULE_PROCESSED;
+
+        if (!debug)
+        {
+            std::copy(spirv.begin() + read, spirv.begin() + read + wordCount, spirv.begin() + write);
+            write += wordCount;
+        }
+
+        read += wordCount;
+    }
+
+    spirv.resize(write);
+}
+
+void ShaderCompiler::writeCache(const std::string& cachePath, const std::vector<uint32_t>& spirv)
+{
+    std::filesystem::create_directories(cacheDirectory);
+
+    // two pipelines can compile the same variant at once, each writes its own temporary
+    std::stringstream temporaryPath;
+    temporaryPath << cachePath << "." << std::hash<std::thread::id>()(std::this_thread::get_id()) << ".tmp";
+
+    {
+        std::ofstream file(temporaryPath.str(), std::ios::binary | std::ios::trunc);
+
+        if (!file.is_open())
+        {
+            throw std::runtime_error("failed to write shader cache!");
+        }
+
+        file.write((const char*)spirv.data(), static_cast<std::streamsize>(spirv.size() * sizeof(uint32_t)));
+
+        if (!file)
+        {
+            throw std::runtime_error("failed to write shader cache!");
+        }
+    }
+
+    std::filesystem::rename(temporaryPath.str(), cachePath);
+}
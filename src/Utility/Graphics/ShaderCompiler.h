@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "../VirtualFileSystem.h"
+
+// Turns GLSL (.vert, .frag, .comp) into SPIR-V at runtime. The result is optimized for performance, stripped of debug
+// instructions and cached on disk under a hash of the source, its stage and the defines, so a variant is only compiled the
+// first time that exact combination shows up and every launch after that is one mapped file.
+// Compiling needs the engine built with DL_SHADER_COMPILER, linked against shaderc (glslang and SPIRV-Tools). Without it
+// cached variants still load, and a source without defines falls back to the .spv checked in next to it.
+// Safe to call from several threads at once.
+class ShaderCompiler {
+
+private:
+	VirtualFileSystem* vfs;
+	std::string cacheDirectory;
+
+	static uint64_t hashVariant(FileView source, const std::string& path, const std::vector<std::string>& defines);
+	static void compile(FileView source, const std::string& path, const std::vector<std::string>& defines, std::vector<uint32_t>& spirv);
+	void writeCache(const std::string& cachePath, const std::vector<uint32_t>& spirv);
+
+public:
+	ShaderCompiler(VirtualFileSystem* vfs, const std::string& cacheDirectory);
+	~ShaderCompiler();
+
+	// SPIR-V for path with defines ("NAME" or "NAME=VALUE"), out of the cache file mapped into cacheFile or compiled into
+	// compiled. A path that already is .spv is loaded as is
+	FileView load(const std::string& path, const std::vector<std::string>& defines, MappedFile& cacheFile, std::vector<uint32_t>& compiled);
+
+	// drops names, source text and line info, none of which the driver needs
+	static void strip(std::vector<uint32_t>& spirv);
+};
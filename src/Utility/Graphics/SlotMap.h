@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <stdexcept>
+
+// Refers to an item in a SlotMap. The generation is bumped every time a slot is freed, so a handle to an item that was
+// removed never matches again, even after the slot has been reused.
+struct SlotHandle {
+	uint32_t index = UINT32_MAX;
+	uint32_t generation = 0;
+
+	bool isNull() const { return index == UINT32_MAX; }
+
+	bool operator==(const SlotHandle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const SlotHandle& other) const { return !(*this == other); }
+};
+
+// Items are kept packed in one vector so iterating them touches contiguous memory. Handles go through a slot table that
+// points into it, and removal swaps the last item into the hole, so insert, lookup and remove are all O(1).
+// Pointers returned by get are only good until the next insert or remove, keep the handle instead.
+template<typename T>
+class SlotMap {
+
+private:
+	struct Slot {
+		uint32_t dense; // index into items while the slot is live, next free slot while it isn't
+		uint32_t generation;
+	};
+
+	std::vector<T> items;
+	std::vector<uint32_t> itemSlots; // slot of every item, to fix up the slot of the item that gets swapped on removal
+	std::vector<Slot> slots;
+	uint32_t freeHead = UINT32_MAX;
+
+public:
+	SlotHandle insert(const T& item)
+	{
+		uint32_t slotIndex;
+
+		if (freeHead != UINT32_MAX)
+		{
+			slotIndex = freeHead;
+			freeHead = slots[slotIndex].dense;
+		}
+		else
+		{
+			slotIndex = static_cast<uint32_t>(slots.size());
+			slots.push_back(Slot{ 0, 0 });
+		}
+
+		slots[slotIndex].dense = static_cast<uint32_t>(items.size());
+		items.push_back(item);
+		itemSlots.push_back(slotIndex);
+
+		SlotHandle handle;
+		handle.index = slotIndex;
+		handle.generation = slots[slotIndex].generation;
+		return handle;
+	}
+
+	bool contains(SlotHandle handle) const
+	{
+		return handle.index < slots.size() && slots[handle.index].generation == handle.generation;
+	}
+
+	// nullptr for stale handles
+	T* get(SlotHandle handle)
+	{
+		if (!contains(handle))
+		{
+			return nullptr;
+		}
+
+		return &items[slots[handle.index].dense];
+	}
+
+	bool remove(SlotHandle handle)
+	{
+		if (!contains(handle))
+		{
+			return false;
+		}
+
+		uint32_t dense = slots[handle.index].dense;
+		uint32_t last = static_cast<uint32_t>(items.size()) - 1;
+
+		if (dense != last)
+		{
+			items[dense] = items[last];
+			itemSlots[dense] = itemSlots[last];
+			slots[itemSlots[dense]].dense = dense;
+		}
+
+		items.pop_back();
+		itemSlots.pop_back();
+
+		slots[handle.index].generation++;
+		slots[handle.index].dense = freeHead;
+		freeHead = handle.index;
+
+		return true;
+	}
+
+	// handle of the item at a packed position, for walking the map with size() and operator[]
+	SlotHandle handleAt(uint32_t dense) const
+	{
+		SlotHandle handle;
+		handle.index = itemSlots.at(dense);
+		handle.generation = slots[handle.index].generation;
+		return handle;
+	}
+
+	void clear()
+	{
+		for (uint32_t i = 0; i < itemSlots.size(); i++)
+		{
+			uint32_t slotIndex = itemSlots[i];
+			slots[slotIndex].generation++;
+			slots[slotIndex].dense = freeHead;
+			freeHead = slotIndex;
+		}
+
+		items.clear();
+		itemSlots.clear();
+	}
+
+	void reserve(uint32_t count)
+	{
+		items.reserve(count);
+		itemSlots.reserve(count);
+		slots.reserve(count);
+	}
+
+	uint32_t size() const { return static_cast<uint32_t>(items.size()); }
+	bool empty() const { return items.empty(); }
+
+	T& operator[](uint32_t dense) { return items[dense]; }
+	const T& operator[](uint32_t dense) const { return items[dense]; }
+};
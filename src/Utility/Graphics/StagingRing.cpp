@@ -0,0 +1,183 @@
+#include "StagingRing.h"
+#include "DLPipeline.h"
+
+
+StagingRing::StagingRing(DLPipeline* pipeline, VkDeviceSize capacity)
+{
+    this->pipeline = pipeline;
+    this->capacity = capacity;
+    head = 0;
+    tail = 0;
+    submittedHead = 0;
+
+    ringPool = new MemoryPool(pipeline);
+
+    ringBuffer = ringPool->createBuffer(capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    ringPool->solidifyMemoryPool(MemoryUsage::UPLOAD);
+
+    if (ringPool->getBuffer(ringBuffer)->allocation.mappedData == nullptr)
+    {
+        throw std::runtime_error("staging ring must be host visible!");
+    }
+}
+
+StagingRing::~StagingRing()
+{
+
+}
+
+VkBuffer StagingRing::getBuffer()
+{
+    return ringPool->getBuffer(ringBuffer)->buffer;
+}
+
+StagingRegion StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+    if (size > capacity)
+    {
+        throw std::runtime_error("upload is larger than the staging ring!");
+    }
+
+    uint64_t start = head;
+    uint64_t position = start % capacity;
+    uint64_t alignedPosition = ((position + alignment - 1) / alignment) * alignment;
+
+    // never straddle the end of the buffer, skip to the front instead
+    if (alignedPosition + size > capacity)
+    {
+        start += capacity - position;
+        alignedPosition = 0;
+    }
+    else
+    {
+        start += alignedPosition - position;
+    }
+
+    uint64_t end = start + size;
+
+    while (end - tail > capacity)
+    {
+        if (retireOldest(true))
+        {
+            continue;
+        }
+
+        // only unsubmitted uploads left, push the setup commands out so they get a fence to wait on
+        if (!hasPendingData() || pipeline->flushSetupCommands() == VK_NULL_HANDLE)
+        {
+            throw std::runtime_error("staging ring is full of unsubmitted uploads!");
+        }
+    }
+
+    head = end;
+
+    MPBuffer* ring = ringPool->getBuffer(ringBuffer);
+
+    StagingRegion region{};
+    region.buffer = ring->buffer;
+    region.offset = alignedPosition;
+    region.size = size;
+    region.data = (void*)((uintptr_t)ring->allocation.mappedData + alignedPosition);
+
+    return region;
+}
+
+void StagingRing::submitUploads(uint64_t value)
+{
+    if (!hasPendingData())
+    {
+        return;
+    }
+
+    submittedHead = head;
+
+    Submission submission{};
+    submission.uploadValue = value;
+    submission.frameFence = VK_NULL_HANDLE;
+    submission.done = false;
+    submission.end = head;
+    inFlight.push_back(submission);
+}
+
+void StagingRing::submitFrame(VkFence fence)
+{
+    if (!hasPendingData())
+    {
+        return;
+    }
+
+    submittedHead = head;
+
+    Submission submission{};
+    submission.uploadValue = 0;
+    submission.frameFence = fence;
+    submission.done = false;
+    submission.end = head;
+    inFlight.push_back(submission);
+}
+
+void StagingRing::completeFrame(VkFence fence)
+{
+    // later submissions with the same fence can't exist yet, the fence is only submitted again after this
+    for (Submission& submission : inFlight)
+    {
+        if (submission.frameFence == fence && !submission.done)
+        {
+            submission.done = true;
+            break;
+        }
+    }
+}
+
+bool StagingRing::retireOldest(bool wait)
+{
+    if (inFlight.empty())
+    {
+        return false;
+    }
+
+    Submission& oldest = inFlight.front();
+
+    if (!oldest.done && oldest.frameFence != VK_NULL_HANDLE)
+    {
+        if (wait)
+        {
+            vkWaitForFences(pipeline->device, 1, &oldest.frameFence, VK_TRUE, UINT64_MAX);
+        }
+        else if (vkGetFenceStatus(pipeline->device, oldest.frameFence) != VK_SUCCESS)
+        {
+            return false;
+        }
+    }
+    else if (!oldest.done)
+    {
+        if (wait)
+        {
+            pipeline->uploadContext->wait(oldest.uploadValue);
+        }
+        else if (!pipeline->uploadContext->isComplete(oldest.uploadValue))
+        {
+            return false;
+        }
+    }
+
+    tail = oldest.end;
+    inFlight.pop_front();
+
+    return true;
+}
+
+void StagingRing::retire()
+{
+    while (retireOldest(false))
+    {
+    }
+}
+
+void StagingRing::destroyStagingRing()
+{
+    inFlight.clear();
+
+    ringPool->destroyMemoryPool();
+    delete ringPool;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdlib>
+#include <deque>
+#include <stdexcept>
+
+#include "MemoryPool.h"
+
+class DLPipeline;
+
+// a slice of the ring that can be written through data and used as a transfer source at buffer + offset
+struct StagingRegion {
+	VkBuffer buffer;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	void* data;
+};
+
+// One persistently mapped host visible buffer that every upload writes into.
+// Space is handed out front to back and given back once the submission that read it has finished. Upload batches are tracked
+// by their UploadContext value rather than their fence, the context resets and reuses its fences as soon as it retires them.
+class StagingRing {
+
+private:
+	struct Submission {
+		uint64_t uploadValue; // upload batches, 0 for a frame
+		VkFence frameFence; // frames, not reset before completeFrame has been called for it
+		bool done;
+		uint64_t end;
+	};
+
+	DLPipeline* pipeline;
+
+	MemoryPool* ringPool;
+	MPHandle ringBuffer;
+	VkDeviceSize capacity;
+
+	// running byte counters, position in the buffer is counter % capacity
+	uint64_t head;
+	uint64_t tail;
+	uint64_t submittedHead;
+
+	std::deque<Submission> inFlight;
+
+	bool retireOldest(bool wait);
+
+public:
+	StagingRing(DLPipeline* pipeline, VkDeviceSize capacity);
+	~StagingRing();
+
+	StagingRegion allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+
+	// everything allocated since the last submit is owned by the upload batch that reaches value
+	void submitUploads(uint64_t value);
+	// everything allocated since the last submit is owned by the frame that signals fence
+	void submitFrame(VkFence fence);
+	// the oldest frame submitted with fence is done, call before the fence is reset
+	void completeFrame(VkFence fence);
+	void retire();
+
+	bool hasPendingData() { return head != submittedHead; }
+	// the most an upload should allocate at once, larger ones are split so a piece can be written while earlier ones are copied
+	VkDeviceSize getChunkSize() { return capacity / 4; }
+	VkBuffer getBuffer();
+
+	void destroyStagingRing();
+};
@@ -0,0 +1,328 @@
+#include "TLSFHeap.h"
+
+#include <stdexcept>
+
+
+TLSFHeap::TLSFHeap()
+{
+    flBitmap = 0;
+    size = 0;
+    freeSize = 0;
+    allocationCount = 0;
+
+    for (uint32_t i = 0; i < FL_COUNT; i++)
+    {
+        slBitmap[i] = 0;
+        for (uint32_t j = 0; j < SL_COUNT; j++)
+        {
+            freeHeads[i][j] = INVALID_NODE;
+        }
+    }
+}
+
+uint32_t TLSFHeap::highestBit(uint64_t value)
+{
+    uint32_t bit = 0;
+    while (value >>= 1)
+    {
+        bit++;
+    }
+    return bit;
+}
+
+uint32_t TLSFHeap::lowestBit(uint64_t value)
+{
+    uint32_t bit = 0;
+    while (!(value & 1))
+    {
+        value >>= 1;
+        bit++;
+    }
+    return bit;
+}
+
+void TLSFHeap::mapping(uint64_t size, uint32_t& fl, uint32_t& sl)
+{
+    if (size < SMALL_SIZE)
+    {
+        fl = 0;
+        sl = static_cast<uint32_t>(size / (SMALL_SIZE / SL_COUNT));
+        return;
+    }
+
+    uint32_t bit = highestBit(size);
+    fl = bit - SMALL_BITS + 1;
+    sl = static_cast<uint32_t>(size >> (bit - SL_BITS)) - SL_COUNT;
+}
+
+void TLSFHeap::init(uint64_t size)
+{
+    this->size = size;
+    freeSize = size;
+    allocationCount = 0;
+
+    nodes.clear();
+    unusedNodes.clear();
+
+    uint32_t node = createNode();
+    nodes[node].offset = 0;
+    nodes[node].size = size;
+
+    insertFree(node);
+}
+
+uint32_t TLSFHeap::createNode()
+{
+    uint32_t node;
+
+    if (!unusedNodes.empty())
+    {
+        node = unusedNodes.back();
+        unusedNodes.pop_back();
+    }
+    else
+    {
+        node = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(Node());
+    }
+
+    nodes[node].offset = 0;
+    nodes[node].size = 0;
+    nodes[node].prevPhysical = INVALID_NODE;
+    nodes[node].nextPhysical = INVALID_NODE;
+    nodes[node].prevFree = INVALID_NODE;
+    nodes[node].nextFree = INVALID_NODE;
+    nodes[node].free = false;
+
+    return node;
+}
+
+void TLSFHeap::releaseNode(uint32_t node)
+{
+    unusedNodes.push_back(node);
+}
+
+void TLSFHeap::insertFree(uint32_t node)
+{
+    uint32_t fl, sl;
+    mapping(nodes[node].size, fl, sl);
+
+    nodes[node].free = true;
+    nodes[node].prevFree = INVALID_NODE;
+    nodes[node].nextFree = freeHeads[fl][sl];
+
+    if (freeHeads[fl][sl] != INVALID_NODE)
+    {
+        nodes[freeHeads[fl][sl]].prevFree = node;
+    }
+
+    freeHeads[fl][sl] = node;
+    slBitmap[fl] |= 1u << sl;
+    flBitmap |= 1ull << fl;
+}
+
+void TLSFHeap::removeFree(uint32_t node)
+{
+    uint32_t fl, sl;
+    mapping(nodes[node].size, fl, sl);
+
+    if (nodes[node].prevFree != INVALID_NODE)
+    {
+        nodes[nodes[node].prevFree].nextFree = nodes[node].nextFree;
+    }
+    else
+    {
+        freeHeads[fl][sl] = nodes[node].nextFree;
+    }
+
+    if (nodes[node].nextFree != INVALID_NODE)
+    {
+        nodes[nodes[node].nextFree].prevFree = nodes[node].prevFree;
+    }
+
+    if (freeHeads[fl][sl] == INVALID_NODE)
+    {
+        slBitmap[fl] &= ~(1u << sl);
+        if (slBitmap[fl] == 0)
+        {
+            flBitmap &= ~(1ull << fl);
+        }
+    }
+
+    nodes[node].free = false;
+    nodes[node].prevFree = INVALID_NODE;
+    nodes[node].nextFree = INVALID_NODE;
+}
+
+uint32_t TLSFHeap::findFree(uint64_t size)
+{
+    // round up to the next list boundary so that any node in the list we land in is big enough
+    if (size < SMALL_SIZE)
+    {
+        uint64_t step = SMALL_SIZE / SL_COUNT;
+        size = (size + step - 1) & ~(step - 1);
+    }
+    else
+    {
+        size += (1ull << (highestBit(size) - SL_BITS)) - 1;
+    }
+
+    uint32_t fl, sl;
+    mapping(size, fl, sl);
+
+    if (fl >= FL_COUNT)
+    {
+        return INVALID_NODE;
+    }
+
+    uint32_t slMap = (sl < SL_COUNT) ? (slBitmap[fl] & (~0u << sl)) : 0;
+
+    if (slMap == 0)
+    {
+        uint64_t flMap = (fl + 1 < FL_COUNT) ? (flBitmap & (~0ull << (fl + 1))) : 0;
+
+        if (flMap == 0)
+        {
+            return INVALID_NODE;
+        }
+
+        fl = lowestBit(flMap);
+        slMap = slBitmap[fl];
+    }
+
+    sl = lowestBit(slMap);
+    return freeHeads[fl][sl];
+}
+
+uint32_t TLSFHeap::splitFront(uint32_t node, uint64_t frontSize)
+{
+    // node keeps the front, the returned node is the back half
+    uint32_t back = createNode();
+
+    nodes[back].offset = nodes[node].offset + frontSize;
+    nodes[back].size = nodes[node].size - frontSize;
+    nodes[back].prevPhysical = node;
+    nodes[back].nextPhysical = nodes[node].nextPhysical;
+
+    if (nodes[node].nextPhysical != INVALID_NODE)
+    {
+        nodes[nodes[node].nextPhysical].prevPhysical = back;
+    }
+
+    nodes[node].nextPhysical = back;
+    nodes[node].size = frontSize;
+
+    return back;
+}
+
+bool TLSFHeap::allocate(uint64_t size, uint64_t alignment, uint64_t& offset, uint32_t& node)
+{
+    if (size == 0)
+    {
+        size = 1;
+    }
+    if (alignment == 0)
+    {
+        alignment = 1;
+    }
+
+    // worst case padding is alignment - 1, so look for a node that can always take it
+    uint32_t found = findFree(size + alignment - 1);
+
+    if (found == INVALID_NODE)
+    {
+        return false;
+    }
+
+    removeFree(found);
+
+    uint64_t alignedOffset = ((nodes[found].offset + alignment - 1) / alignment) * alignment;
+    uint64_t padding = alignedOffset - nodes[found].offset;
+
+    if (padding > 0)
+    {
+        uint32_t aligned = splitFront(found, padding);
+        insertFree(found);
+        found = aligned;
+    }
+
+    if (nodes[found].size - size >= MIN_SPLIT_SIZE)
+    {
+        uint32_t remainder = splitFront(found, size);
+        insertFree(remainder);
+    }
+
+    freeSize -= nodes[found].size;
+    allocationCount++;
+
+    offset = nodes[found].offset;
+    node = found;
+
+    return true;
+}
+
+void TLSFHeap::free(uint32_t node)
+{
+    if (node >= nodes.size() || nodes[node].free)
+    {
+        throw std::runtime_error("freeing invalid TLSF node!");
+    }
+
+    freeSize += nodes[node].size;
+    allocationCount--;
+
+    uint32_t next = nodes[node].nextPhysical;
+    if (next != INVALID_NODE && nodes[next].free)
+    {
+        removeFree(next);
+
+        nodes[node].size += nodes[next].size;
+        nodes[node].nextPhysical = nodes[next].nextPhysical;
+        if (nodes[next].nextPhysical != INVALID_NODE)
+        {
+            nodes[nodes[next].nextPhysical].prevPhysical = node;
+        }
+
+        releaseNode(next);
+    }
+
+    uint32_t prev = nodes[node].prevPhysical;
+    if (prev != INVALID_NODE && nodes[prev].free)
+    {
+        removeFree(prev);
+
+        nodes[prev].size += nodes[node].size;
+        nodes[prev].nextPhysical = nodes[node].nextPhysical;
+        if (nodes[node].nextPhysical != INVALID_NODE)
+        {
+            nodes[nodes[node].nextPhysical].prevPhysical = prev;
+        }
+
+        releaseNode(node);
+        node = prev;
+    }
+
+    insertFree(node);
+}
+
+uint64_t TLSFHeap::getLargestFreeRange() const
+{
+    if (flBitmap == 0)
+    {
+        return 0;
+    }
+
+    uint32_t fl = highestBit(flBitmap);
+    uint32_t sl = highestBit(slBitmap[fl]);
+
+    uint64_t largest = 0;
+    for (uint32_t node = freeHeads[fl][sl]; node != INVALID_NODE; node = nodes[node].nextFree)
+    {
+        if (nodes[node].size > largest)
+        {
+            largest = nodes[node].size;
+        }
+    }
+
+    return largest;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Two-level segregated fit bookkeeping for one contiguous range of memory.
+// Only offsets are tracked here; the owner decides what the range actually is (a VkDeviceMemory block, a buffer...)
+class TLSFHeap {
+
+public:
+	static const uint32_t INVALID_NODE = UINT32_MAX;
+
+	TLSFHeap();
+
+	void init(uint64_t size);
+
+	bool allocate(uint64_t size, uint64_t alignment, uint64_t& offset, uint32_t& node);
+	void free(uint32_t node);
+
+	uint64_t getSize() const { return size; }
+	uint64_t getFreeSize() const { return freeSize; }
+	uint64_t getLargestFreeRange() const;
+	uint32_t getAllocationCount() const { return allocationCount; }
+	bool isEmpty() const { return allocationCount == 0; }
+
+private:
+	// second level splits every power of two into 16 lists
+	static const uint32_t SL_BITS = 4;
+	static const uint32_t SL_COUNT = 1 << SL_BITS;
+	static const uint32_t FL_COUNT = 64;
+
+	// everything below this size lands in first level 0, in 16 byte steps
+	static const uint32_t SMALL_BITS = 8;
+	static const uint64_t SMALL_SIZE = 1ull << SMALL_BITS;
+
+	// leftovers smaller than this stay attached to the allocation instead of becoming a new free node
+	static const uint64_t MIN_SPLIT_SIZE = 16;
+
+	struct Node {
+		uint64_t offset;
+		uint64_t size;
+		uint32_t prevPhysical;
+		uint32_t nextPhysical;
+		uint32_t prevFree;
+		uint32_t nextFree;
+		bool free;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<uint32_t> unusedNodes;
+
+	uint64_t flBitmap;
+	uint32_t slBitmap[FL_COUNT];
+	uint32_t freeHeads[FL_COUNT][SL_COUNT];
+
+	uint64_t size;
+	uint64_t freeSize;
+	uint32_t allocationCount;
+
+	static uint32_t highestBit(uint64_t value);
+	static uint32_t lowestBit(uint64_t value);
+	static void mapping(uint64_t size, uint32_t& fl, uint32_t& sl);
+
+	uint32_t createNode();
+	void releaseNode(uint32_t node);
+
+	void insertFree(uint32_t node);
+	void removeFree(uint32_t node);
+	uint32_t findFree(uint64_t size);
+
+	uint32_t splitFront(uint32_t node, uint64_t frontSize);
+};
@@ -0,0 +1,482 @@
+#include "TextureBaker.h"
+
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+const uint32_t BAKED_TEXTURE_VERSION = 1;
+
+struct BakedTextureHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipCount;
+    uint64_t dataSize;
+};
+
+// srgb is what the texels hold, but averaging for mips has to happen in linear light or the mips get darker
+static float srgbToLinear(unsigned char value)
+{
+    // built once, the static init is thread safe and bakes run on the worker threads
+    static const std::vector<float> table = []()
+        {
+            std::vector<float> values(256);
+            for (int i = 0; i < 256; i++)
+            {
+                float c = i / 255.0f;
+                values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+            return values;
+        }();
+
+    return table[value];
+}
+
+static unsigned char linearToSrgb(float value)
+{
+    float c = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+    return (unsigned char)std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f);
+}
+
+// bytes a mip of format takes, 0 for a format this build doesn't bake
+static uint64_t mipByteSize(VkFormat format, uint32_t width, uint32_t height)
+{
+    uint64_t blocks = (uint64_t)((width + 3) / 4) * ((height + 3) / 4);
+
+    switch (format)
+    {
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        return (uint64_t)width * height * 4;
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        return blocks * 8;
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+        return blocks * 16;
+    default:
+        return 0;
+    }
+}
+
+static uint16_t pack565(const int color[3])
+{
+    return (uint16_t)(((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3));
+}
+
+static void unpack565(uint16_t packed, int color[3])
+{
+    int r = (packed >> 11) & 31;
+    int g = (packed >> 5) & 63;
+    int b = packed & 31;
+
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+std::vector<unsigned char> TextureBaker::downsample(const std::vector<unsigned char>& rgba, uint32_t width, uint32_t height)
+{
+    uint32_t mipWidth = std::max(width / 2, 1u);
+    uint32_t mipHeight = std::max(height / 2, 1u);
+
+    std::vector<unsigned char> mip(mipWidth * mipHeight * 4);
+
+    for (uint32_t y = 0; y < mipHeight; y++)
+    {
+        for (uint32_t x = 0; x < mipWidth; x++)
+        {
+            // 2x2 box, clamped so odd sizes just reuse the last row / column
+            uint32_t x0 = std::min(x * 2, width - 1);
+            uint32_t x1 = std::min(x * 2 + 1, width - 1);
+            uint32_t y0 = std::min(y * 2, height - 1);
+            uint32_t y1 = std::min(y * 2 + 1, height - 1);
+
+            const unsigned char* texels[4] = {
+                &rgba[(y0 * width + x0) * 4], &rgba[(y0 * width + x1) * 4],
+                &rgba[(y1 * width + x0) * 4], &rgba[(y1 * width + x1) * 4]
+            };
+
+            unsigned char* out = &mip[(y * mipWidth + x) * 4];
+
+            for (int c = 0; c < 3; c++)
+            {
+                float sum = 0.0f;
+                for (int i = 0; i < 4; i++)
+                {
+                    sum += srgbToLinear(texels[i][c]);
+                }
+                out[c] = linearToSrgb(sum / 4.0f);
+            }
+
+            out[3] = (unsigned char)((texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3] + 2) / 4);
+        }
+    }
+
+    return mip;
+}
+
+void TextureBaker::encodeColorBlock(const unsigned char block[64], unsigned char* out)
+{
+    // bounding box of the block's colors, pulled in a little since the extremes are usually outliers
+    int minColor[3] = { 255, 255, 255 };
+    int maxColor[3] = { 0, 0, 0 };
+
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            minColor[c] = std::min(minColor[c], (int)block[i * 4 + c]);
+            maxColor[c] = std::max(maxColor[c], (int)block[i * 4 + c]);
+        }
+    }
+
+    for (int c = 0; c < 3; c++)
+    {
+        int inset = (maxColor[c] - minColor[c]) >> 4;
+        minColor[c] += inset;
+        maxColor[c] -= inset;
+    }
+
+    // the box only gives the main diagonal, flip channels that go down while the widest one goes up
+    int axis = 0;
+    for (int c = 1; c < 3; c++)
+    {
+        if (maxColor[c] - minColor[c] > maxColor[axis] - minColor[axis])
+        {
+            axis = c;
+        }
+    }
+
+    for (int c = 0; c < 3; c++)
+    {
+        if (c == axis)
+        {
+            continue;
+        }
+
+        int covariance = 0;
+        int axisCenter = (minColor[axis] + maxColor[axis]) / 2;
+        int center = (minColor[c] + maxColor[c]) / 2;
+
+        for (int i = 0; i < 16; i++)
+        {
+            covariance += ((int)block[i * 4 + axis] - axisCenter) * ((int)block[i * 4 + c] - center);
+        }
+
+        if (covariance < 0)
+        {
+            std::swap(minColor[c], maxColor[c]);
+        }
+    }
+
+    uint16_t color0 = pack565(maxColor);
+    uint16_t color1 = pack565(minColor);
+
+    // color0 > color1 selects the 4 color mode
+    if (color0 < color1)
+    {
+        std::swap(color0, color1);
+    }
+
+    int palette[4][3];
+    unpack565(color0, palette[0]);
+    unpack565(color1, palette[1]);
+
+    for (int c = 0; c < 3; c++)
+    {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    uint32_t indices = 0;
+
+    if (color0 != color1)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0;
+            int bestDistance = INT32_MAX;
+
+            for (int p = 0; p < 4; p++)
+            {
+                int distance = 0;
+                for (int c = 0; c < 3; c++)
+                {
+                    int d = (int)block[i * 4 + c] - palette[p][c];
+                    distance += d * d;
+                }
+
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+
+            indices |= (uint32_t)best << (i * 2);
+        }
+    }
+
+    out[0] = color0 & 0xFF;
+    out[1] = color0 >> 8;
+    out[2] = color1 & 0xFF;
+    out[3] = color1 >> 8;
+    out[4] = indices & 0xFF;
+    out[5] = (indices >> 8) & 0xFF;
+    out[6] = (indices >> 16) & 0xFF;
+    out[7] = (indices >> 24) & 0xFF;
+}
+
+void TextureBaker::encodeAlphaBlock(const unsigned char block[64], unsigned char* out)
+{
+    int alpha0 = 0;
+    int alpha1 = 255;
+
+    for (int i = 0; i < 16; i++)
+    {
+        alpha0 = std::max(alpha0, (int)block[i * 4 + 3]);
+        alpha1 = std::min(alpha1, (int)block[i * 4 + 3]);
+    }
+
+    // alpha0 > alpha1 selects 6 interpolated values between them
+    int palette[8];
+    palette[0] = alpha0;
+    palette[1] = alpha1;
+
+    for (int p = 2; p < 8; p++)
+    {
+        palette[p] = ((8 - p) * alpha0 + (p - 1) * alpha1) / 7;
+    }
+
+    uint64_t indices = 0;
+
+    if (alpha0 != alpha1)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0;
+            int bestDistance = INT32_MAX;
+
+            for (int p = 0; p < 8; p++)
+            {
+                int distance = std::abs((int)block[i * 4 + 3] - palette[p]);
+
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+
+            indices |= (uint64_t)best << (i * 3);
+        }
+    }
+
+    out[0] = (unsigned char)alpha0;
+    out[1] = (unsigned char)alpha1;
+
+    for (int i = 0; i < 6; i++)
+    {
+        out[2 + i] = (indices >> (i * 8)) & 0xFF;
+    }
+}
+
+BakedTexture TextureBaker::bake(const unsigned char* rgba, uint32_t width, uint32_t height, bool compress)
+{
+    bool hasAlpha = false;
+
+    for (uint32_t i = 0; i < width * height; i++)
+    {
+        if (rgba[i * 4 + 3] != 255)
+        {
+            hasAlpha = true;
+            break;
+        }
+    }
+
+    BakedTexture texture{};
+    texture.width = width;
+    texture.height = height;
+
+    if (!compress)
+    {
+        texture.format = VK_FORMAT_R8G8B8A8_SRGB;
+    }
+    else
+    {
+        texture.format = hasAlpha ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+    }
+
+    uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+
+    std::vector<unsigned char> level(rgba, rgba + (size_t)width * height * 4);
+    uint32_t mipWidth = width;
+    uint32_t mipHeight = height;
+
+    for (uint32_t i = 0; i < mipLevels; i++)
+    {
+        BakedMip mip{};
+        mip.width = mipWidth;
+        mip.height = mipHeight;
+        mip.offset = texture.data.size();
+
+        if (!compress)
+        {
+            texture.data.insert(texture.data.end(), level.begin(), level.end());
+        }
+        else
+        {
+            uint32_t blocksWide = (mipWidth + 3) / 4;
+            uint32_t blocksHigh = (mipHeight + 3) / 4;
+            size_t blockSize = hasAlpha ? 16 : 8;
+
+            texture.data.resize(mip.offset + blocksWide * blocksHigh * blockSize);
+            unsigned char* out = &texture.data[mip.offset];
+
+            for (uint32_t by = 0; by < blocksHigh; by++)
+            {
+                for (uint32_t bx = 0; bx < blocksWide; bx++)
+                {
+                    // partial blocks at the edges repeat the last texel
+                    unsigned char block[64];
+
+                    for (uint32_t y = 0; y < 4; y++)
+                    {
+                        for (uint32_t x = 0; x < 4; x++)
+                        {
+                            uint32_t sx = std::min(bx * 4 + x, mipWidth - 1);
+                            uint32_t sy = std::min(by * 4 + y, mipHeight - 1);
+                            memcpy(&block[(y * 4 + x) * 4], &level[(sy * mipWidth + sx) * 4], 4);
+                        }
+                    }
+
+                    if (hasAlpha)
+                    {
+                        encodeAlphaBlock(block, out);
+                        out += 8;
+                    }
+
+                    encodeColorBlock(block, out);
+                    out += 8;
+                }
+            }
+        }
+
+        mip.size = texture.data.size() - mip.offset;
+        texture.mips.push_back(mip);
+
+        if (i + 1 < mipLevels)
+        {
+            level = downsample(level, mipWidth, mipHeight);
+            mipWidth = std::max(mipWidth / 2, 1u);
+            mipHeight = std::max(mipHeight / 2, 1u);
+        }
+    }
+
+    return texture;
+}
+
+std::string TextureBaker::bakedPath(const std::string& source)
+{
+    return source + ".dltex";
+}
+
+bool TextureBaker::read(FileView file, BakedTexture& texture)
+{
+    if (!file.isValid() || file.size < sizeof(BakedTextureHeader))
+    {
+        return false;
+    }
+
+    const BakedTextureHeader* header = (const BakedTextureHeader*)file.data;
+
+    if (memcmp(header->magic, "DLTX", 4) != 0 || header->version != BAKED_TEXTURE_VERSION || header->mipCount == 0)
+    {
+        return false;
+    }
+
+    uint64_t mipsOffset = sizeof(BakedTextureHeader);
+    uint64_t dataOffset = mipsOffset + sizeof(BakedMip) * (uint64_t)header->mipCount;
+
+    if (dataOffset > file.size || header->dataSize > file.size - dataOffset)
+    {
+        return false;
+    }
+
+    if (header->width == 0 || header->height == 0 || header->mipCount > 32)
+    {
+        return false;
+    }
+
+    const BakedMip* mips = (const BakedMip*)(file.data + mipsOffset);
+    uint32_t mipWidth = header->width;
+    uint32_t mipHeight = header->height;
+
+    // every copy region has to match what the image expects for that level, or the upload reads past the data
+    for (uint32_t i = 0; i < header->mipCount; i++)
+    {
+        const BakedMip& mip = mips[i];
+        uint64_t expectedSize = mipByteSize((VkFormat)header->format, mipWidth, mipHeight);
+
+        if (expectedSize == 0 || mip.width != mipWidth || mip.height != mipHeight || mip.size != expectedSize
+            || mip.offset > header->dataSize || mip.size > header->dataSize - mip.offset)
+        {
+            return false;
+        }
+
+        mipWidth = std::max(mipWidth / 2, 1u);
+        mipHeight = std::max(mipHeight / 2, 1u);
+    }
+
+    texture.format = (VkFormat)header->format;
+    texture.width = header->width;
+    texture.height = header->height;
+    texture.mips.assign(mips, mips + header->mipCount);
+
+    // the one copy, out of the mapping
+    texture.data.assign(file.data + dataOffset, file.data + dataOffset + header->dataSize);
+
+    return true;
+}
+
+void TextureBaker::write(const std::string& path, const BakedTexture& texture)
+{
+    BakedTextureHeader header{};
+    memcpy(header.magic, "DLTX", 4);
+    header.version = BAKED_TEXTURE_VERSION;
+    header.format = (uint32_t)texture.format;
+    header.width = texture.width;
+    header.height = texture.height;
+    header.mipCount = static_cast<uint32_t>(texture.mips.size());
+    header.dataSize = texture.data.size();
+
+    // written aside and moved into place, so a half written file is never picked up
+    std::string temporaryPath = path + ".tmp";
+
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+
+        if (!file.is_open())
+        {
+            throw std::runtime_error("failed to write baked texture!");
+        }
+
+        file.write((const char*)&header, sizeof(header));
+        file.write((const char*)texture.mips.data(), sizeof(BakedMip) * texture.mips.size());
+        file.write((const char*)texture.data.data(), texture.data.size());
+
+        if (!file)
+        {
+            throw std::runtime_error("failed to write baked texture!");
+        }
+    }
+
+    std::filesystem::rename(temporaryPath, path);
+}
+
+bool TextureBaker::isCompressed(VkFormat format)
+{
+    return format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_BC3_SRGB_BLOCK;
+}
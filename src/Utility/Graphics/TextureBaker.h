@@ -0,0 +1,49 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "../VirtualFileSystem.h"
+
+struct BakedMip {
+	uint32_t width;
+	uint32_t height;
+	uint64_t offset; // into BakedTexture::data
+	uint64_t size;
+};
+
+// A texture with its whole mip chain already built, in the exact layout it gets copied into the image with.
+// Block compressed (BC1 when opaque, BC3 with alpha) or plain rgba8 for devices without BC support.
+struct BakedTexture {
+	VkFormat format;
+	uint32_t width;
+	uint32_t height;
+	std::vector<BakedMip> mips;
+	std::vector<unsigned char> data;
+};
+
+// Builds the mips on the cpu and compresses them, this is the slow part that shouldn't happen on every launch.
+// Baked files (.dltex) sit next to their source and are rebuilt when the source is newer.
+class TextureBaker {
+
+private:
+	static std::vector<unsigned char> downsample(const std::vector<unsigned char>& rgba, uint32_t width, uint32_t height);
+	static void encodeColorBlock(const unsigned char block[64], unsigned char* out);
+	static void encodeAlphaBlock(const unsigned char block[64], unsigned char* out);
+
+public:
+	static BakedTexture bake(const unsigned char* rgba, uint32_t width, uint32_t height, bool compress);
+
+	static std::string bakedPath(const std::string& source);
+
+	// false if file isn't a baked texture this build can read
+	static bool read(FileView file, BakedTexture& texture);
+	static void write(const std::string& path, const BakedTexture& texture);
+
+	static bool isCompressed(VkFormat format);
+};
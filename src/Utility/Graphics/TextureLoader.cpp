@@ -0,0 +1,270 @@
+#include "TextureLoader.h"
+#include "DLPipeline.h"
+
+
+TextureLoader::TextureLoader(DLPipeline* pipeline, ThreadPool* threadPool)
+{
+    this->pipeline = pipeline;
+    this->threadPool = threadPool;
+    textures = SlotMap<Texture>();
+
+    createPlaceholder();
+}
+
+TextureLoader::~TextureLoader()
+{
+
+}
+
+void TextureLoader::createPlaceholder()
+{
+    uint32_t white = 0xFFFFFFFF;
+
+    pipeline->uploadTexture(&white, 1, 1, 1, placeholderImage, placeholderAllocation);
+    placeholderView = pipeline->createImageView(placeholderImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+
+    // goes out with the rest of the setup commands, every frame waits for those
+}
+
+TextureHandle TextureLoader::load(const std::string& path)
+{
+    Texture texture{};
+    texture.path = path;
+    texture.state = TextureState::DECODING;
+    texture.uploadValue = 0;
+    texture.image = VK_NULL_HANDLE;
+    texture.allocation = DeviceAllocation();
+    texture.view = VK_NULL_HANDLE;
+    texture.mipLevels = 1;
+
+    bool compress = pipeline->textureCompressionEnabled;
+    VirtualFileSystem* vfs = pipeline->vfs;
+
+    texture.decode = threadPool->submit([path, compress, vfs]()
+        {
+            return decode(path, compress, vfs);
+        }).share();
+
+    return textures.insert(texture);
+}
+
+BakedTexture TextureLoader::decode(const std::string& path, bool compress, VirtualFileSystem* vfs)
+{
+    std::string bakedPath = TextureBaker::bakedPath(path);
+
+    // a packed baked texture is what shipped, there's no source to compare it against
+    MappedFile bakedFile;
+    BakedTexture baked{};
+    if ((vfs->isPacked(bakedPath) || MappedFile::isUpToDate(path, bakedPath)) && TextureBaker::read(vfs->open(bakedPath, bakedFile), baked)
+        && TextureBaker::isCompressed(baked.format) == compress)
+    {
+        return baked;
+    }
+
+    bakedFile.close();
+
+    // first launch or the source changed
+    MappedFile sourceFile;
+    FileView source = vfs->open(path, sourceFile);
+
+    int width, height, channels;
+    stbi_uc* pixels = source.isValid()
+        ? stbi_load_from_memory(source.data, static_cast<int>(source.size), &width, &height, &channels, STBI_rgb_alpha)
+        : nullptr;
+
+    if (!pixels)
+    {
+        throw std::runtime_error("failed to load texture image!");
+    }
+
+    baked = TextureBaker::bake(pixels, width, height, compress);
+    stbi_image_free(pixels);
+
+    // not being able to cache it only costs the next launch
+    try
+    {
+        TextureBaker::write(bakedPath, baked);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << bakedPath << ": " << e.what() << std::endl;
+    }
+
+    return baked;
+}
+
+void TextureLoader::prepare(const std::string& path, bool compress, VirtualFileSystem* vfs)
+{
+    // an up to date baked file is only read here, load then reads it again instead of baking it
+    try
+    {
+        decode(path, compress, vfs);
+    }
+    catch (const std::exception&)
+    {
+        // not fatal, load reports it and the texture stays the placeholder
+    }
+}
+
+void TextureLoader::upload(Texture& texture, const BakedTexture& baked)
+{
+    texture.mipLevels = static_cast<uint32_t>(baked.mips.size());
+
+    // the data is copied into the staging ring while recording, so it can go as soon as this returns
+    pipeline->uploadBakedTexture(baked, texture.image, texture.allocation);
+
+    texture.view = pipeline->createImageView(texture.image, baked.format, VK_IMAGE_ASPECT_COLOR_BIT, texture.mipLevels);
+    texture.state = TextureState::UPLOADING;
+}
+
+void TextureLoader::update()
+{
+    std::vector<uint32_t> uploaded;
+
+    for (uint32_t i = 0; i < textures.size(); i++)
+    {
+        Texture& texture = textures[i];
+
+        if (texture.state != TextureState::DECODING
+            || texture.decode.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            continue;
+        }
+
+        try
+        {
+            upload(texture, texture.decode.get());
+            uploaded.push_back(i);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << texture.path << ": " << e.what() << std::endl;
+            texture.state = TextureState::FAILED;
+        }
+
+        texture.decode = std::shared_future<BakedTexture>();
+    }
+
+    // everything recorded above goes out in one submission
+    if (!uploaded.empty())
+    {
+        pipeline->flushSetupCommands();
+
+        for (uint32_t i : uploaded)
+        {
+            textures[i].uploadValue = pipeline->uploadContext->getSubmittedValue();
+        }
+    }
+
+    for (uint32_t i = 0; i < textures.size(); i++)
+    {
+        if (textures[i].state == TextureState::UPLOADING && pipeline->uploadContext->isComplete(textures[i].uploadValue))
+        {
+            textures[i].state = TextureState::RESIDENT;
+        }
+    }
+}
+
+void TextureLoader::wait(TextureHandle handle)
+{
+    Texture* texture = textures.get(handle);
+
+    if (texture == nullptr)
+    {
+        return;
+    }
+
+    if (texture->state == TextureState::DECODING)
+    {
+        texture->decode.wait();
+        update();
+    }
+
+    if (getState(handle) == TextureState::UPLOADING)
+    {
+        pipeline->uploadContext->waitIdle();
+        update();
+    }
+}
+
+TextureState TextureLoader::getState(TextureHandle handle)
+{
+    Texture* texture = textures.get(handle);
+
+    if (texture == nullptr)
+    {
+        return TextureState::FAILED;
+    }
+
+    return texture->state;
+}
+
+VkImageView TextureLoader::getView(TextureHandle handle)
+{
+    Texture* texture = textures.get(handle);
+
+    if (texture == nullptr || texture->state != TextureState::RESIDENT)
+    {
+        return placeholderView;
+    }
+
+    return texture->view;
+}
+
+void TextureLoader::unload(TextureHandle handle)
+{
+    Texture* texture = textures.get(handle);
+
+    if (texture == nullptr)
+    {
+        return;
+    }
+
+    // the job still references the pool, let it finish
+    if (texture->state == TextureState::DECODING)
+    {
+        texture->decode.wait();
+    }
+
+    // frames never waited on the upload, so it may still be writing the image
+    if (texture->state == TextureState::UPLOADING && !pipeline->uploadContext->isComplete(texture->uploadValue))
+    {
+        pipeline->uploadContext->waitIdle();
+    }
+
+    if (texture->image != VK_NULL_HANDLE)
+    {
+        vkDestroyImageView(pipeline->device, texture->view, nullptr);
+        vkDestroyImage(pipeline->device, texture->image, nullptr);
+        pipeline->allocator->free(texture->allocation);
+    }
+
+    textures.remove(handle);
+}
+
+void TextureLoader::destroyTextureLoader()
+{
+    for (uint32_t i = 0; i < textures.size(); i++)
+    {
+        Texture& texture = textures[i];
+
+        // the job still references the pool, let it finish
+        if (texture.state == TextureState::DECODING)
+        {
+            texture.decode.wait();
+        }
+
+        if (texture.image != VK_NULL_HANDLE)
+        {
+            vkDestroyImageView(pipeline->device, texture.view, nullptr);
+            vkDestroyImage(pipeline->device, texture.image, nullptr);
+            pipeline->allocator->free(texture.allocation);
+        }
+    }
+
+    textures.clear();
+
+    vkDestroyImageView(pipeline->device, placeholderView, nullptr);
+    vkDestroyImage(pipeline->device, placeholderImage, nullptr);
+    pipeline->allocator->free(placeholderAllocation);
+}
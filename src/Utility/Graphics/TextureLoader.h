@@ -0,0 +1,85 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdlib>
+#include <string>
+#include <future>
+#include <stdexcept>
+
+#include "DeviceAllocator.h"
+#include "SlotMap.h"
+#include "TextureBaker.h"
+#include "../ThreadPool.h"
+#include "../MappedFile.h"
+#include "../VirtualFileSystem.h"
+
+class DLPipeline;
+
+typedef SlotHandle TextureHandle;
+
+enum class TextureState {
+	DECODING, // on a worker thread, reading the baked file or baking it
+	UPLOADING, // copies and mip generation submitted, not finished yet
+	RESIDENT,
+	FAILED
+};
+
+// Loads baked textures on the thread pool and uploads them from the main thread once the data is ready. Sources without an
+// up to date baked file are baked on the worker first and the result is written out for next time.
+// Until a texture is resident getView hands out a 1x1 placeholder, so it can be bound right away.
+class TextureLoader {
+
+private:
+	struct Texture {
+		std::string path;
+		TextureState state;
+		std::shared_future<BakedTexture> decode;
+		uint64_t uploadValue;
+
+		VkImage image;
+		DeviceAllocation allocation;
+		VkImageView view;
+		uint32_t mipLevels;
+	};
+
+	DLPipeline* pipeline;
+	ThreadPool* threadPool;
+
+	SlotMap<Texture> textures;
+
+	VkImage placeholderImage;
+	DeviceAllocation placeholderAllocation;
+	VkImageView placeholderView;
+
+	void createPlaceholder();
+	// the baked file if it's current, otherwise the source baked and written out for next time. Runs on a worker
+	static BakedTexture decode(const std::string& path, bool compress, VirtualFileSystem* vfs);
+	void upload(Texture& texture, const BakedTexture& baked);
+
+public:
+	TextureLoader(DLPipeline* pipeline, ThreadPool* threadPool);
+	~TextureLoader();
+
+	// starts decoding on the pool and returns straight away
+	TextureHandle load(const std::string& path);
+	// bakes the texture if its baked file is stale, without a loader or a device, so it can run while Vulkan is still being set up
+	static void prepare(const std::string& path, bool compress, VirtualFileSystem* vfs);
+
+	// main thread only. Uploads whatever finished decoding and marks finished uploads resident
+	void update();
+	// blocks until the texture is resident (or failed)
+	void wait(TextureHandle handle);
+
+	TextureState getState(TextureHandle handle);
+	bool isResident(TextureHandle handle) { return getState(handle) == TextureState::RESIDENT; }
+
+	// the placeholder until the texture is resident
+	VkImageView getView(TextureHandle handle);
+
+	// destroys the image right away, the caller makes sure no frame in flight still samples it
+	void unload(TextureHandle handle);
+
+	void destroyTextureLoader();
+};
@@ -0,0 +1,518 @@
+#include "UploadContext.h"
+#include "DLPipeline.h"
+
+
+UploadContext::UploadContext(DLPipeline* pipeline, VkQueue graphicsQueue, uint32_t graphicsFamily, VkQueue transferQueue, uint32_t transferFamily)
+{
+    this->pipeline = pipeline;
+    this->graphicsQueue = graphicsQueue;
+    this->graphicsFamily = graphicsFamily;
+    this->transferQueue = transferQueue;
+    this->transferFamily = transferFamily;
+    async = transferFamily != graphicsFamily;
+
+    recording = false;
+    current = Batch{};
+    timeline = VK_NULL_HANDLE;
+    timelineValue = 0;
+    completedValue = 0;
+
+    graphicsCommandPool = createCommandPool(graphicsFamily);
+    transferCommandPool = async ? createCommandPool(transferFamily) : graphicsCommandPool;
+
+    if (async)
+    {
+        VkSemaphoreTypeCreateInfo typeInfo{};
+        typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        typeInfo.initialValue = 0;
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreInfo.pNext = &typeInfo;
+
+        if (vkCreateSemaphore(pipeline->device, &semaphoreInfo, nullptr, &timeline) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create upload timeline semaphore!");
+        }
+    }
+}
+
+UploadContext::~UploadContext()
+{
+
+}
+
+VkCommandPool UploadContext::createCommandPool(uint32_t queueFamilyIndex)
+{
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = queueFamilyIndex;
+
+    VkCommandPool pool;
+    if (vkCreateCommandPool(pipeline->device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create upload command pool!");
+    }
+
+    return pool;
+}
+
+VkCommandBuffer UploadContext::allocateCommandBuffer(VkCommandPool pool)
+{
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = pool;
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    if (vkAllocateCommandBuffers(pipeline->device, &allocInfo, &commandBuffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to allocate upload command buffer!");
+    }
+
+    return commandBuffer;
+}
+
+UploadContext::Batch UploadContext::acquireBatch()
+{
+    retire();
+
+    if (!freeBatches.empty())
+    {
+        Batch batch = freeBatches.back();
+        freeBatches.pop_back();
+        return batch;
+    }
+
+    Batch batch{};
+    batch.graphicsCommandBuffer = allocateCommandBuffer(graphicsCommandPool);
+    batch.transferCommandBuffer = async ? allocateCommandBuffer(transferCommandPool) : batch.graphicsCommandBuffer;
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    if (vkCreateFence(pipeline->device, &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create upload fence!");
+    }
+
+    return batch;
+}
+
+void UploadContext::beginBatch()
+{
+    if (recording)
+    {
+        return;
+    }
+
+    current = acquireBatch();
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(current.graphicsCommandBuffer, &beginInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to begin recording upload command buffer!");
+    }
+
+    if (async && vkBeginCommandBuffer(current.transferCommandBuffer, &beginInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to begin recording upload command buffer!");
+    }
+
+    recording = true;
+}
+
+VkCommandBuffer UploadContext::getCommandBuffer()
+{
+    beginBatch();
+    return current.transferCommandBuffer;
+}
+
+VkCommandBuffer UploadContext::getGraphicsCommandBuffer()
+{
+    beginBatch();
+    return current.graphicsCommandBuffer;
+}
+
+void UploadContext::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, const VkBufferCopy& region)
+{
+    beginBatch();
+
+    // a batch only ever copies between a handful of buffer pairs, the staging ring and the geometry blocks
+    for (BufferCopies& copies : current.bufferCopies)
+    {
+        if (copies.srcBuffer == srcBuffer && copies.dstBuffer == dstBuffer)
+        {
+            copies.regions.push_back(region);
+            return;
+        }
+    }
+
+    BufferCopies copies{};
+    copies.srcBuffer = srcBuffer;
+    copies.dstBuffer = dstBuffer;
+    copies.regions.push_back(region);
+    current.bufferCopies.push_back(copies);
+}
+
+void UploadContext::releaseBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size)
+{
+    beginBatch();
+
+    // pieces of one upload land back to back, they're handed over as one range
+    if (!current.bufferReleases.empty())
+    {
+        BufferRange& last = current.bufferReleases.back();
+
+        if (last.buffer == buffer && last.size != VK_WHOLE_SIZE && size != VK_WHOLE_SIZE && last.offset + last.size == offset)
+        {
+            last.size += size;
+            return;
+        }
+    }
+
+    current.bufferReleases.push_back(BufferRange{ buffer, offset, size });
+}
+
+void UploadContext::recordBufferCopies()
+{
+    for (BufferCopies& copies : current.bufferCopies)
+    {
+        vkCmdCopyBuffer(current.transferCommandBuffer, copies.srcBuffer, copies.dstBuffer, static_cast<uint32_t>(copies.regions.size()),
+            copies.regions.data());
+    }
+    current.bufferCopies.clear();
+
+    if (current.bufferReleases.empty())
+    {
+        return;
+    }
+
+    std::vector<VkBufferMemoryBarrier> barriers(current.bufferReleases.size());
+
+    for (size_t i = 0; i < barriers.size(); i++)
+    {
+        barriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barriers[i].buffer = current.bufferReleases[i].buffer;
+        barriers[i].offset = current.bufferReleases[i].offset;
+        barriers[i].size = current.bufferReleases[i].size;
+    }
+    current.bufferReleases.clear();
+
+    VkAccessFlags readAccess = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT
+        | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    VkPipelineStageFlags readStages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+        | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+    if (!async)
+    {
+        for (VkBufferMemoryBarrier& barrier : barriers)
+        {
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = readAccess;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        }
+
+        vkCmdPipelineBarrier(current.graphicsCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, readStages, 0,
+            0, nullptr,
+            static_cast<uint32_t>(barriers.size()), barriers.data(),
+            0, nullptr);
+        return;
+    }
+
+    // release, the access on the other queue is done by the acquire
+    for (VkBufferMemoryBarrier& barrier : barriers)
+    {
+        barrier.srcQueueFamilyIndex = transferFamily;
+        barrier.dstQueueFamilyIndex = graphicsFamily;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+    }
+
+    vkCmdPipelineBarrier(current.transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+        0, nullptr,
+        static_cast<uint32_t>(barriers.size()), barriers.data(),
+        0, nullptr);
+
+    // acquire
+    for (VkBufferMemoryBarrier& barrier : barriers)
+    {
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = readAccess;
+    }
+
+    vkCmdPipelineBarrier(current.graphicsCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, readStages, 0,
+        0, nullptr,
+        static_cast<uint32_t>(barriers.size()), barriers.data(),
+        0, nullptr);
+}
+
+void UploadContext::releaseImage(VkImage image, VkImageSubresourceRange range, VkImageLayout oldLayout, VkImageLayout newLayout,
+    VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask)
+{
+    beginBatch();
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.image = image;
+    barrier.subresourceRange = range;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+
+    if (!async)
+    {
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = dstAccessMask;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+        vkCmdPipelineBarrier(current.graphicsCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier);
+        return;
+    }
+
+    // both halves must use the same layouts, the transition happens once between them
+    barrier.srcQueueFamilyIndex = transferFamily;
+    barrier.dstQueueFamilyIndex = graphicsFamily;
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+
+    vkCmdPipelineBarrier(current.transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+        0, nullptr,
+        0, nullptr,
+        1, &barrier);
+
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = dstAccessMask;
+
+    vkCmdPipelineBarrier(current.graphicsCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStageMask, 0,
+        0, nullptr,
+        0, nullptr,
+        1, &barrier);
+}
+
+void UploadContext::deferDestroy(VkBuffer buffer, DeviceAllocation allocation)
+{
+    beginBatch();
+
+    DeadBuffer deadBuffer{};
+    deadBuffer.buffer = buffer;
+    deadBuffer.allocation = allocation;
+    current.deadBuffers.push_back(deadBuffer);
+}
+
+VkFence UploadContext::flush()
+{
+    if (!recording)
+    {
+        return VK_NULL_HANDLE;
+    }
+
+    recordBufferCopies();
+
+    if (async && vkEndCommandBuffer(current.transferCommandBuffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to record upload command buffer!");
+    }
+
+    if (vkEndCommandBuffer(current.graphicsCommandBuffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to record upload command buffer!");
+    }
+
+    current.value = ++timelineValue;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+
+    if (!async)
+    {
+        submitInfo.pCommandBuffers = &current.graphicsCommandBuffer;
+
+        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, current.fence) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to submit upload command buffer!");
+        }
+
+        current.acquireSubmitted = true;
+    }
+    else
+    {
+        // copies on the transfer queue, the timeline reaches the batch's value once they're done
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues = &current.value;
+
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.pCommandBuffers = &current.transferCommandBuffer;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &timeline;
+
+        if (vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to submit upload command buffer!");
+        }
+
+        // the acquires and blits are held back until the copies are done (submitAcquires), nothing on the graphics
+        // queue ever waits on the transfer queue
+        current.acquireSubmitted = false;
+    }
+
+    inFlight.push_back(current);
+    recording = false;
+
+    return current.fence;
+}
+
+void UploadContext::submitAcquires(uint64_t waitValue)
+{
+    for (Batch& batch : inFlight)
+    {
+        if (batch.acquireSubmitted)
+        {
+            continue;
+        }
+
+        if (batch.value <= waitValue)
+        {
+            VkSemaphoreWaitInfo waitInfo{};
+            waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+            waitInfo.semaphoreCount = 1;
+            waitInfo.pSemaphores = &timeline;
+            waitInfo.pValues = &batch.value;
+
+            vkWaitSemaphores(pipeline->device, &waitInfo, UINT64_MAX);
+        }
+        else
+        {
+            uint64_t counter = 0;
+            vkGetSemaphoreCounterValue(pipeline->device, timeline, &counter);
+
+            // later batches can't have finished their copies before this one
+            if (counter < batch.value)
+            {
+                break;
+            }
+        }
+
+        // the copies are done, so this goes through without a semaphore wait and frames behind it aren't held up
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &batch.graphicsCommandBuffer;
+
+        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, batch.fence) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to submit upload command buffer!");
+        }
+
+        batch.acquireSubmitted = true;
+    }
+}
+
+void UploadContext::retire()
+{
+    if (async)
+    {
+        submitAcquires(0);
+    }
+
+    // a batch still waiting on its copies hasn't submitted its fence, so it stops here like any unfinished one
+    while (!inFlight.empty() && vkGetFenceStatus(pipeline->device, inFlight.front().fence) == VK_SUCCESS)
+    {
+        Batch batch = inFlight.front();
+        inFlight.pop_front();
+
+        completedValue = batch.value;
+
+        for (DeadBuffer& deadBuffer : batch.deadBuffers)
+        {
+            vkDestroyBuffer(pipeline->device, deadBuffer.buffer, nullptr);
+            pipeline->allocator->free(deadBuffer.allocation);
+        }
+        batch.deadBuffers.clear();
+
+        vkResetFences(pipeline->device, 1, &batch.fence);
+        vkResetCommandBuffer(batch.graphicsCommandBuffer, 0);
+
+        if (async)
+        {
+            vkResetCommandBuffer(batch.transferCommandBuffer, 0);
+        }
+
+        freeBatches.push_back(batch);
+    }
+}
+
+bool UploadContext::isComplete(uint64_t value)
+{
+    if (value <= completedValue)
+    {
+        return true;
+    }
+
+    retire();
+    return value <= completedValue;
+}
+
+void UploadContext::wait(uint64_t value)
+{
+    // the fence is only submitted with the acquire half, which in turn waits for the copies
+    if (async)
+    {
+        submitAcquires(value);
+    }
+
+    // batches finish in the order they were submitted, so retire picks up everything before it as well
+    for (Batch& batch : inFlight)
+    {
+        if (batch.value >= value)
+        {
+            vkWaitForFences(pipeline->device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+            break;
+        }
+    }
+
+    retire();
+}
+
+void UploadContext::waitIdle()
+{
+    flush();
+    wait(timelineValue);
+}
+
+void UploadContext::destroyUploadContext()
+{
+    waitIdle();
+
+    for (Batch& batch : freeBatches)
+    {
+        vkDestroyFence(pipeline->device, batch.fence, nullptr);
+    }
+    freeBatches.clear();
+
+    if (timeline != VK_NULL_HANDLE)
+    {
+        vkDestroySemaphore(pipeline->device, timeline, nullptr);
+    }
+
+    // destroying the pools frees the command buffers
+    if (async)
+    {
+        vkDestroyCommandPool(pipeline->device, transferCommandPool, nullptr);
+    }
+    vkDestroyCommandPool(pipeline->device, graphicsCommandPool, nullptr);
+}
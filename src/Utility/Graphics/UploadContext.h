@@ -0,0 +1,121 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdlib>
+#include <vector>
+#include <deque>
+#include <stdexcept>
+
+#include "DeviceAllocator.h"
+
+class DLPipeline;
+
+// Collects setup work (copies, layout transitions, blits) into one command buffer and submits it all at once with a fence,
+// instead of a submit + vkQueueWaitIdle per operation.
+// With a separate transfer family the copies go to the transfer queue and anything that needs graphics (blits, shader read
+// transitions, ownership acquires) goes to a second command buffer on the graphics queue. That one is only submitted once a
+// timeline semaphore shows the copies are done, so the graphics queue, and the frames on it, never wait on the transfer queue.
+// With a single family both command buffers are the same one.
+class UploadContext {
+
+private:
+	struct DeadBuffer {
+		VkBuffer buffer;
+		DeviceAllocation allocation;
+	};
+
+	// every region copied between the same two buffers in a batch, recorded as one vkCmdCopyBuffer
+	struct BufferCopies {
+		VkBuffer srcBuffer;
+		VkBuffer dstBuffer;
+		std::vector<VkBufferCopy> regions;
+	};
+
+	struct BufferRange {
+		VkBuffer buffer;
+		VkDeviceSize offset;
+		VkDeviceSize size;
+	};
+
+	struct Batch {
+		VkCommandBuffer transferCommandBuffer;
+		VkCommandBuffer graphicsCommandBuffer;
+		VkFence fence;
+		uint64_t value;
+		bool acquireSubmitted; // async only, the graphics half goes out once the copies have reached value
+		std::vector<DeadBuffer> deadBuffers;
+		std::vector<BufferCopies> bufferCopies;
+		std::vector<BufferRange> bufferReleases;
+	};
+
+	DLPipeline* pipeline;
+
+	VkQueue transferQueue;
+	VkQueue graphicsQueue;
+	uint32_t transferFamily;
+	uint32_t graphicsFamily;
+	bool async;
+
+	VkCommandPool transferCommandPool;
+	VkCommandPool graphicsCommandPool;
+
+	// async only, signaled by the transfer half of each batch with the batch's value
+	VkSemaphore timeline;
+	uint64_t timelineValue;
+	uint64_t completedValue;
+
+	Batch current;
+	bool recording;
+
+	std::vector<Batch> freeBatches;
+	std::deque<Batch> inFlight;
+
+	VkCommandPool createCommandPool(uint32_t queueFamilyIndex);
+	VkCommandBuffer allocateCommandBuffer(VkCommandPool pool);
+	Batch acquireBatch();
+	void beginBatch();
+	void recordBufferCopies();
+	// submits the graphics half of every batch whose copies are done, blocking for the copies of those up to waitValue
+	void submitAcquires(uint64_t waitValue);
+
+public:
+	UploadContext(DLPipeline* pipeline, VkQueue graphicsQueue, uint32_t graphicsFamily, VkQueue transferQueue, uint32_t transferFamily);
+	~UploadContext();
+
+	// copies and transfer layout transitions
+	VkCommandBuffer getCommandBuffer();
+	// blits and anything that touches graphics stages, runs after everything in getCommandBuffer
+	VkCommandBuffer getGraphicsCommandBuffer();
+
+	// queued until flush, then every region between the same two buffers goes out as one copy with a region list
+	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, const VkBufferCopy& region);
+	// hands a resource written on the transfer side over to the graphics queue. Without async this is just a barrier.
+	// Buffer ranges are handed over together at flush, after the batch's queued copies
+	void releaseBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+	void releaseImage(VkImage image, VkImageSubresourceRange range, VkImageLayout oldLayout, VkImageLayout newLayout,
+		VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask);
+
+	// for sources the batch being recorded still reads, destroyed once it has finished
+	void deferDestroy(VkBuffer buffer, DeviceAllocation allocation);
+
+	bool isRecording() { return recording; }
+	bool isAsync() { return async; }
+
+	// submits everything recorded so far without waiting, returns the fence that signals when it's done
+	VkFence flush();
+	// sends out the graphics halves whose copies are done and recycles the batches that have finished
+	void retire();
+	void waitIdle();
+
+	// value that is reached once everything flushed so far has finished
+	uint64_t getSubmittedValue() { return timelineValue; }
+	// value that is reached once everything recorded so far has been flushed and has finished
+	uint64_t getRecordedValue() { return recording ? timelineValue + 1 : timelineValue; }
+	bool isComplete(uint64_t value);
+	// blocks until the batch that reaches value has finished, value must have been flushed
+	void wait(uint64_t value);
+
+	void destroyUploadContext();
+};
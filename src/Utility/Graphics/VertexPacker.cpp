@@ -0,0 +1,371 @@
+#include "VertexPacker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+// largest position error the 16 bit encodings may add, as a fraction of the mesh's largest extent
+const float POSITION_TOLERANCE = 1.0f / 16384.0f;
+
+// half a texel of an 4096 wide texture
+const float TEXCOORD_TOLERANCE = 1.0f / 8192.0f;
+
+const uint16_t HALF_ONE = 0x3c00;
+
+static uint32_t alignAttribute(uint32_t offset)
+{
+    return (offset + 3) & ~3u;
+}
+
+uint16_t VertexPacker::toHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t floatExponent = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (floatExponent == 0xff)
+    {
+        return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    }
+
+    int32_t exponent = static_cast<int32_t>(floatExponent) - 127 + 15;
+
+    if (exponent >= 31)
+    {
+        return static_cast<uint16_t>(sign | 0x7c00);
+    }
+
+    // round to nearest even on whatever falls off the bottom, a carry into the exponent is still the right answer
+    uint32_t shift = 13;
+    uint32_t half;
+
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+        {
+            return static_cast<uint16_t>(sign);
+        }
+
+        mantissa |= 0x800000;
+        shift = 14 - exponent;
+        half = mantissa >> shift;
+    }
+    else
+    {
+        half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> shift);
+    }
+
+    uint32_t rest = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+
+    if (rest > halfway || (rest == halfway && (half & 1)))
+    {
+        half++;
+    }
+
+    return static_cast<uint16_t>(sign | half);
+}
+
+float VertexPacker::fromHalf(uint16_t value)
+{
+    uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+
+    if (exponent == 0)
+    {
+        float magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign ? -magnitude : magnitude;
+    }
+
+    uint32_t bits = sign | (exponent == 0x1f ? 0x7f800000 | (mantissa << 13) : ((exponent - 15 + 127) << 23) | (mantissa << 13));
+
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+uint16_t VertexPacker::packUnorm16(float value)
+{
+    return static_cast<uint16_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+}
+
+uint32_t VertexPacker::packColor(const Vector3& color)
+{
+    uint32_t packed = 0xff000000;
+
+    for (int c = 0; c < 3; c++)
+    {
+        packed |= static_cast<uint32_t>(std::lround(std::clamp(color[c], 0.0f, 1.0f) * 255.0f)) << (c * 8);
+    }
+
+    return packed;
+}
+
+VertexFormat VertexPacker::chooseFormat(const std::vector<Vertex>& vertices, const float boundsMin[3], const float boundsMax[3])
+{
+    VertexFormat format{};
+
+    float extent = 0.0f;
+
+    for (int c = 0; c < 3; c++)
+    {
+        extent = std::max(extent, boundsMax[c] - boundsMin[c]);
+        format.positionOffset[c] = boundsMin[c];
+        format.positionScale[c] = boundsMax[c] - boundsMin[c];
+    }
+
+    // measured by round tripping every vertex, the halves are exact near the origin and coarse far from it
+    float unormError = 0.0f;
+    float halfError = 0.0f;
+    float texCoordHalfError = 0.0f;
+    bool texCoordsNormalized = true;
+
+    format.constantColor = vertices.empty() ? 0xffffffff : packColor(vertices[0].color);
+
+    for (const Vertex& vertex : vertices)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            float scale = format.positionScale[c];
+            float decoded = scale > 0.0f ? boundsMin[c] + (packUnorm16((vertex.pos[c] - boundsMin[c]) / scale) / 65535.0f) * scale : boundsMin[c];
+
+            unormError = std::max(unormError, std::fabs(decoded - vertex.pos[c]));
+            halfError = std::max(halfError, std::fabs(fromHalf(toHalf(vertex.pos[c])) - vertex.pos[c]));
+        }
+
+        for (int c = 0; c < 2; c++)
+        {
+            texCoordsNormalized = texCoordsNormalized && vertex.texCoord[c] >= 0.0f && vertex.texCoord[c] <= 1.0f;
+            texCoordHalfError = std::max(texCoordHalfError, std::fabs(fromHalf(toHalf(vertex.texCoord[c])) - vertex.texCoord[c]));
+        }
+
+        if (packColor(vertex.color) != format.constantColor)
+        {
+            format.hasColor = 1;
+        }
+    }
+
+    float positionTolerance = extent * POSITION_TOLERANCE;
+
+    if (std::min(unormError, halfError) > positionTolerance)
+    {
+        format.position = PositionEncoding::FLOAT32;
+    }
+    else
+    {
+        format.position = unormError <= halfError ? PositionEncoding::UNORM16 : PositionEncoding::FLOAT16;
+    }
+
+    if (texCoordsNormalized)
+    {
+        format.texCoord = TexCoordEncoding::UNORM16;
+    }
+    else
+    {
+        format.texCoord = texCoordHalfError <= TEXCOORD_TOLERANCE ? TexCoordEncoding::FLOAT16 : TexCoordEncoding::FLOAT32;
+    }
+
+    // only unorm positions are stored relative to the bounds
+    if (format.position != PositionEncoding::UNORM16)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            format.positionOffset[c] = 0.0f;
+            format.positionScale[c] = 1.0f;
+        }
+    }
+
+    uint32_t offset = format.position == PositionEncoding::FLOAT32 ? 3 * sizeof(float) : 4 * sizeof(uint16_t);
+
+    format.texCoordOffset = offset;
+    offset += format.texCoord == TexCoordEncoding::FLOAT32 ? 2 * sizeof(float) : 2 * sizeof(uint16_t);
+
+    format.colorOffset = format.hasColor ? alignAttribute(offset) : 0;
+    offset = format.hasColor ? format.colorOffset + sizeof(uint32_t) : offset;
+
+    format.stride = alignAttribute(offset);
+    format.indexSize = vertices.size() < 65536 ? sizeof(uint16_t) : sizeof(uint32_t);
+
+    return format;
+}
+
+void VertexPacker::packVertex(const VertexFormat& format, const Vertex& vertex, unsigned char* out)
+{
+    if (format.position == PositionEncoding::FLOAT32)
+    {
+        memcpy(out, &vertex.pos[0], 3 * sizeof(float));
+    }
+    else
+    {
+        uint16_t position[4];
+
+        for (int c = 0; c < 3; c++)
+        {
+            if (format.position == PositionEncoding::FLOAT16)
+            {
+                position[c] = toHalf(vertex.pos[c]);
+            }
+            else
+            {
+                float scale = format.positionScale[c];
+                position[c] = scale > 0.0f ? packUnorm16((vertex.pos[c] - format.positionOffset[c]) / scale) : 0;
+            }
+        }
+
+        position[3] = format.position == PositionEncoding::FLOAT16 ? HALF_ONE : 65535;
+        memcpy(out, position, sizeof(position));
+    }
+
+    if (format.texCoord == TexCoordEncoding::FLOAT32)
+    {
+        float texCoord[2] = { vertex.texCoord[0], vertex.texCoord[1] };
+        memcpy(out + format.texCoordOffset, texCoord, sizeof(texCoord));
+    }
+    else
+    {
+        uint16_t texCoord[2];
+
+        for (int c = 0; c < 2; c++)
+        {
+            texCoord[c] = format.texCoord == TexCoordEncoding::FLOAT16 ? toHalf(vertex.texCoord[c]) : packUnorm16(vertex.texCoord[c]);
+        }
+
+        memcpy(out + format.texCoordOffset, texCoord, sizeof(texCoord));
+    }
+
+    if (format.hasColor)
+    {
+        uint32_t color = packColor(vertex.color);
+        memcpy(out + format.colorOffset, &color, sizeof(color));
+    }
+}
+
+PackedMesh VertexPacker::pack(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+{
+    PackedMesh mesh{};
+    mesh.vertexCount = static_cast<uint32_t>(vertices.size());
+    mesh.indexCount = static_cast<uint32_t>(indices.size());
+    mesh.lodCount = 1;
+    mesh.lods[0] = { 0, mesh.indexCount, 0.0f, 0, 0 };
+
+    for (int c = 0; c < 3; c++)
+    {
+        mesh.boundsMin[c] = vertices.empty() ? 0.0f : std::numeric_limits<float>::max();
+        mesh.boundsMax[c] = vertices.empty() ? 0.0f : std::numeric_limits<float>::lowest();
+    }
+
+    for (const Vertex& vertex : vertices)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            mesh.boundsMin[c] = std::min(mesh.boundsMin[c], vertex.pos[c]);
+            mesh.boundsMax[c] = std::max(mesh.boundsMax[c], vertex.pos[c]);
+        }
+    }
+
+    mesh.format = chooseFormat(vertices, mesh.boundsMin, mesh.boundsMax);
+
+    mesh.vertices.resize(static_cast<size_t>(mesh.format.stride) * vertices.size());
+
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        packVertex(mesh.format, vertices[i], mesh.vertices.data() + i * mesh.format.stride);
+    }
+
+    mesh.indices.resize(static_cast<size_t>(mesh.format.indexSize) * indices.size());
+
+    if (mesh.format.indexSize == sizeof(uint16_t))
+    {
+        uint16_t* shortIndices = (uint16_t*)mesh.indices.data();
+
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            shortIndices[i] = static_cast<uint16_t>(indices[i]);
+        }
+    }
+    else if (!indices.empty())
+    {
+        memcpy(mesh.indices.data(), indices.data(), indices.size() * sizeof(uint32_t));
+    }
+
+    return mesh;
+}
+
+bool VertexPacker::isValid(const VertexFormat& format)
+{
+    return format.position <= PositionEncoding::UNORM16 && format.texCoord <= TexCoordEncoding::UNORM16
+        && (format.indexSize == sizeof(uint16_t) || format.indexSize == sizeof(uint32_t))
+        && format.stride > 0 && format.texCoordOffset < format.stride && format.colorOffset < format.stride;
+}
+
+bool VertexPacker::sameLayout(const VertexFormat& a, const VertexFormat& b)
+{
+    // the quantization ranges, color and index size don't change the vertex input state
+    return a.position == b.position && a.texCoord == b.texCoord && (a.hasColor != 0) == (b.hasColor != 0)
+        && a.stride == b.stride && a.texCoordOffset == b.texCoordOffset && a.colorOffset == b.colorOffset;
+}
+
+VkIndexType VertexPacker::getIndexType(const VertexFormat& format)
+{
+    return format.indexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+std::vector<VkVertexInputBindingDescription> VertexPacker::getBindingDescriptions(const VertexFormat& format)
+{
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions(format.hasColor ? 1 : 2);
+
+    bindingDescriptions[0].binding = 0;
+    bindingDescriptions[0].stride = format.stride;
+    bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    // one instance, so every vertex reads the same color
+    if (!format.hasColor)
+    {
+        bindingDescriptions[1].binding = 1;
+        bindingDescriptions[1].stride = sizeof(uint32_t);
+        bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+    }
+
+    return bindingDescriptions;
+}
+
+std::vector<VkVertexInputAttributeDescription> VertexPacker::getAttributeDescriptions(const VertexFormat& format)
+{
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions(3);
+
+    const VkFormat positionFormats[] = { VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R16G16B16A16_SFLOAT, VK_FORMAT_R16G16B16A16_UNORM };
+    const VkFormat texCoordFormats[] = { VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R16G16_SFLOAT, VK_FORMAT_R16G16_UNORM };
+
+    attributeDescriptions[0].binding = 0;
+    attributeDescriptions[0].location = 0;
+    attributeDescriptions[0].format = positionFormats[static_cast<uint32_t>(format.position)];
+    attributeDescriptions[0].offset = 0;
+
+    attributeDescriptions[1].binding = format.hasColor ? 0 : 1;
+    attributeDescriptions[1].location = 1;
+    attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+    attributeDescriptions[1].offset = format.colorOffset;
+
+    attributeDescriptions[2].binding = 0;
+    attributeDescriptions[2].location = 2;
+    attributeDescriptions[2].format = texCoordFormats[static_cast<uint32_t>(format.texCoord)];
+    attributeDescriptions[2].offset = format.texCoordOffset;
+
+    return attributeDescriptions;
+}
+
+Matrix4 VertexPacker::positionTransform(const VertexFormat& format)
+{
+    // scales then translates, laid out like the rest of Matrix4 with the translation in the last row
+    return Matrix4{
+        format.positionScale[0], 0.0f, 0.0f, 0.0f,
+        0.0f, format.positionScale[1], 0.0f, 0.0f,
+        0.0f, 0.0f, format.positionScale[2], 0.0f,
+        format.positionOffset[0], format.positionOffset[1], format.positionOffset[2], 1.0f
+    };
+}
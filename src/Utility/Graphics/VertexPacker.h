@@ -0,0 +1,87 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "Vertex.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
+#include "../Math/Matrix4.h"
+
+enum class PositionEncoding : uint32_t {
+	FLOAT32, // r32g32b32_sfloat
+	FLOAT16, // r16g16b16a16_sfloat
+	UNORM16 // r16g16b16a16_unorm across the mesh bounds, decoded by positionTransform
+};
+
+enum class TexCoordEncoding : uint32_t {
+	FLOAT32, // r32g32_sfloat
+	FLOAT16, // r16g16_sfloat
+	UNORM16 // r16g16_unorm, only when every uv is in [0, 1]
+};
+
+// How one mesh's vertices sit in its vertex buffer. Picked at import from what the data needs and stored with the mesh,
+// so it's plain data with fixed size fields.
+struct VertexFormat {
+	PositionEncoding position;
+	TexCoordEncoding texCoord;
+	uint32_t hasColor; // when 0 every vertex is constantColor, which is fed to the shader from a one element buffer
+	uint32_t constantColor; // rgba8
+	uint32_t stride;
+	uint32_t texCoordOffset;
+	uint32_t colorOffset;
+	uint32_t indexSize; // 2 below 65536 vertices, otherwise 4
+	float positionOffset[3]; // unorm positions decode to offset + value * scale
+	float positionScale[3];
+};
+
+// An imported mesh converted to its VertexFormat, ready to be cached or copied into buffers as is.
+struct PackedMesh {
+	VertexFormat format;
+	std::vector<unsigned char> vertices;
+	std::vector<unsigned char> indices;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	float boundsMin[3];
+	float boundsMax[3];
+	MeshLod lods[MAX_MESH_LODS];
+	uint32_t lodCount;
+	std::vector<Meshlet> meshlets;
+	uint64_t hash; // of the format, vertices and indices, set on import so loading never hashes the geometry
+};
+
+// Converts the full float Vertex the importer and optimizer work on into the smallest layout that still holds the mesh.
+class VertexPacker {
+
+private:
+	static VertexFormat chooseFormat(const std::vector<Vertex>& vertices, const float boundsMin[3], const float boundsMax[3]);
+	static void packVertex(const VertexFormat& format, const Vertex& vertex, unsigned char* out);
+
+	static uint32_t packColor(const Vector3& color);
+	static uint16_t packUnorm16(float value);
+
+public:
+	// one lod covering every index, the caller fills in the real lods and meshlets
+	static PackedMesh pack(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+
+	// false for formats this build doesn't know, e.g. out of a corrupt cache
+	static bool isValid(const VertexFormat& format);
+
+	// true when both formats read through the same vertex input state, so meshes in either can share a pipeline
+	static bool sameLayout(const VertexFormat& a, const VertexFormat& b);
+
+	static VkIndexType getIndexType(const VertexFormat& format);
+
+	// binding 0 is the vertex buffer, binding 1 the constant color buffer when the format has no color
+	static std::vector<VkVertexInputBindingDescription> getBindingDescriptions(const VertexFormat& format);
+	static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(const VertexFormat& format);
+
+	// goes in front of the model matrix, undoes the position quantization
+	static Matrix4 positionTransform(const VertexFormat& format);
+
+	static uint16_t toHalf(float value);
+	static float fromHalf(uint16_t value);
+};
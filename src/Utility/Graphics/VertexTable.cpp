@@ -0,0 +1,115 @@
+#include "VertexTable.h"
+
+#include <cstring>
+
+
+// the floats of a vertex as bits, with -0 folded into 0 so equal values always match
+static void vertexKey(const Vertex& vertex, uint32_t key[8])
+{
+    float values[8] = {
+        vertex.pos[0], vertex.pos[1], vertex.pos[2],
+        vertex.color[0], vertex.color[1], vertex.color[2],
+        vertex.texCoord[0], vertex.texCoord[1]
+    };
+
+    for (int i = 0; i < 8; i++)
+    {
+        float value = values[i] + 0.0f;
+        memcpy(&key[i], &value, sizeof(float));
+    }
+}
+
+VertexTable::VertexTable(size_t expectedVertices)
+{
+    // keep the load factor under a half
+    size_t capacity = 16;
+    while (capacity < expectedVertices * 2)
+    {
+        capacity *= 2;
+    }
+
+    slots.assign(capacity, UINT32_MAX);
+    mask = static_cast<uint32_t>(capacity - 1);
+
+    vertices.reserve(expectedVertices);
+    hashes.reserve(expectedVertices);
+}
+
+uint32_t VertexTable::hash(const Vertex& vertex)
+{
+    uint32_t key[8];
+    vertexKey(vertex, key);
+
+    uint64_t h = 0x9E3779B97F4A7C15ull;
+
+    for (int i = 0; i < 8; i++)
+    {
+        h = (h ^ key[i]) * 0xFF51AFD7ED558CCDull;
+        h ^= h >> 29;
+    }
+
+    // final avalanche so the low bits used for the slot depend on everything
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+
+    return static_cast<uint32_t>(h);
+}
+
+bool VertexTable::equal(const Vertex& a, const Vertex& b)
+{
+    uint32_t keyA[8];
+    uint32_t keyB[8];
+    vertexKey(a, keyA);
+    vertexKey(b, keyB);
+
+    return memcmp(keyA, keyB, sizeof(keyA)) == 0;
+}
+
+void VertexTable::grow()
+{
+    slots.assign(slots.size() * 2, UINT32_MAX);
+    mask = static_cast<uint32_t>(slots.size() - 1);
+
+    for (uint32_t i = 0; i < vertices.size(); i++)
+    {
+        uint32_t slot = hashes[i] & mask;
+
+        while (slots[slot] != UINT32_MAX)
+        {
+            slot = (slot + 1) & mask;
+        }
+
+        slots[slot] = i;
+    }
+}
+
+uint32_t VertexTable::insert(const Vertex& vertex)
+{
+    uint32_t vertexHash = hash(vertex);
+    uint32_t slot = vertexHash & mask;
+
+    while (slots[slot] != UINT32_MAX)
+    {
+        uint32_t index = slots[slot];
+
+        if (hashes[index] == vertexHash && equal(vertices[index], vertex))
+        {
+            return index;
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    uint32_t index = static_cast<uint32_t>(vertices.size());
+    vertices.push_back(vertex);
+    hashes.push_back(vertexHash);
+    slots[slot] = index;
+
+    if (vertices.size() * 2 > slots.size())
+    {
+        grow();
+    }
+
+    return index;
+}
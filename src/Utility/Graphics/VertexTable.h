@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Vertex.h"
+
+// Deduplicates vertices by their exact bits. Open addressing with linear probing over a flat array of indices into vertices,
+// so there is no node allocation per entry like an unordered_map, and the hash mixes every float instead of xoring them.
+class VertexTable {
+
+private:
+	std::vector<uint32_t> slots; // index into vertices, UINT32_MAX when empty
+	std::vector<uint32_t> hashes; // per vertex, so growing doesn't hash everything again
+	uint32_t mask;
+
+	void grow();
+
+public:
+	std::vector<Vertex> vertices;
+
+	VertexTable(size_t expectedVertices = 0);
+
+	// index of vertex, added to the end of vertices if it isn't there yet
+	uint32_t insert(const Vertex& vertex);
+
+	static uint32_t hash(const Vertex& vertex);
+	static bool equal(const Vertex& a, const Vertex& b);
+};
@@ -0,0 +1,265 @@
+#include "JobGraph.h"
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <exception>
+#include <iomanip>
+
+
+JobId JobGraph::add(const std::string& name, JobThread thread, std::function<void()> work, const std::vector<JobId>& dependencies)
+{
+    JobId id = static_cast<JobId>(jobs.size());
+
+    for (JobId dependency : dependencies)
+    {
+        if (dependency >= id)
+        {
+            throw std::runtime_error("failed to add " + name + ", it depends on a job that doesn't exist yet!");
+        }
+    }
+
+    Job job{};
+    job.name = name;
+    job.thread = thread;
+    job.work = std::move(work);
+    job.dependencies = dependencies;
+    job.previousOnMain = id;
+    jobs.push_back(std::move(job));
+
+    for (JobId dependency : dependencies)
+    {
+        jobs[dependency].dependents.push_back(id);
+    }
+
+    return id;
+}
+
+void JobGraph::run(ThreadPool* threadPool)
+{
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<JobId> readyOnMain;
+    uint32_t finished = 0;
+    uint32_t workersRunning = 0;
+    std::exception_ptr failure;
+
+    std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now();
+
+    std::function<double()> now = [runStart]()
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+        };
+
+    // everything below is called with the mutex held
+    std::function<void(JobId)> start;
+
+    std::function<void(JobId)> release = [&](JobId id)
+        {
+            if (failure)
+            {
+                return;
+            }
+
+            if (jobs[id].thread == JobThread::MAIN)
+            {
+                readyOnMain.push_back(id);
+                changed.notify_all();
+            }
+            else
+            {
+                start(id);
+            }
+        };
+
+    std::function<void(JobId, std::exception_ptr)> complete = [&](JobId id, std::exception_ptr error)
+        {
+            jobs[id].end = now();
+            finished++;
+
+            if (error)
+            {
+                if (!failure)
+                {
+                    failure = error;
+                }
+
+                return;
+            }
+
+            for (JobId dependent : jobs[id].dependents)
+            {
+                if (--jobs[dependent].waitingOn == 0)
+                {
+                    release(dependent);
+                }
+            }
+        };
+
+    start = [&](JobId id)
+        {
+            workersRunning++;
+
+            threadPool->enqueue([&, id]()
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        jobs[id].start = now();
+                    }
+
+                    std::exception_ptr error;
+
+                    try
+                    {
+                        jobs[id].work();
+                    }
+                    catch (...)
+                    {
+                        error = std::current_exception();
+                    }
+
+                    std::lock_guard<std::mutex> lock(mutex);
+                    complete(id, error);
+                    workersRunning--;
+                    changed.notify_all();
+                });
+        };
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    for (JobId id = 0; id < jobs.size(); id++)
+    {
+        jobs[id].waitingOn = static_cast<uint32_t>(jobs[id].dependencies.size());
+        jobs[id].start = 0.0;
+        jobs[id].end = 0.0;
+        jobs[id].previousOnMain = id;
+    }
+
+    for (JobId id = 0; id < jobs.size(); id++)
+    {
+        if (jobs[id].waitingOn == 0)
+        {
+            release(id);
+        }
+    }
+
+    JobId lastOnMain = static_cast<JobId>(jobs.size());
+
+    while (true)
+    {
+        // the worker jobs hold references to this frame, so even a failed run waits for them
+        changed.wait(lock, [&]()
+            {
+                return !readyOnMain.empty() || workersRunning == 0;
+            });
+
+        if (readyOnMain.empty() || failure)
+        {
+            if (workersRunning == 0)
+            {
+                break;
+            }
+
+            readyOnMain.clear();
+            continue;
+        }
+
+        JobId id = readyOnMain.front();
+        readyOnMain.pop_front();
+
+        jobs[id].start = now();
+        jobs[id].previousOnMain = lastOnMain < jobs.size() ? lastOnMain : id;
+        lastOnMain = id;
+
+        lock.unlock();
+
+        std::exception_ptr error;
+
+        try
+        {
+            jobs[id].work();
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        lock.lock();
+        complete(id, error);
+    }
+
+    if (failure)
+    {
+        std::rethrow_exception(failure);
+    }
+
+    if (finished != jobs.size())
+    {
+        throw std::runtime_error("failed to run every job in the graph!");
+    }
+}
+
+JobId JobGraph::criticalPredecessor(JobId job)
+{
+    // a main thread step can also have waited for the main thread to be free
+    JobId latest = jobs[job].previousOnMain;
+
+    for (JobId dependency : jobs[job].dependencies)
+    {
+        if (latest == job || jobs[dependency].end > jobs[latest].end)
+        {
+            latest = dependency;
+        }
+    }
+
+    return latest;
+}
+
+void JobGraph::printReport(std::ostream& out)
+{
+    if (jobs.empty())
+    {
+        return;
+    }
+
+    JobId last = 0;
+
+    for (JobId id = 1; id < jobs.size(); id++)
+    {
+        if (jobs[id].end > jobs[last].end)
+        {
+            last = id;
+        }
+    }
+
+    // walk back from the step that finished last, always through whatever it waited on longest
+    std::vector<bool> critical(jobs.size(), false);
+
+    for (JobId id = last; !critical[id]; id = criticalPredecessor(id))
+    {
+        critical[id] = true;
+    }
+
+    double busy = 0.0;
+
+    for (const Job& job : jobs)
+    {
+        busy += job.end - job.start;
+    }
+
+    out << std::fixed << std::setprecision(1);
+    out << "startup: " << jobs[last].end * 1000.0 << " ms, " << busy * 1000.0 << " ms of work in " << jobs.size()
+        << " steps, * is the critical path" << std::endl;
+
+    for (JobId id = 0; id < jobs.size(); id++)
+    {
+        const Job& job = jobs[id];
+
+        out << (critical[id] ? " * " : "   ") << std::left << std::setw(28) << job.name << std::right
+            << (job.thread == JobThread::MAIN ? "main  " : "worker") << std::setw(9) << job.start * 1000.0
+            << " ->" << std::setw(9) << job.end * 1000.0 << " ms" << std::setw(9) << (job.end - job.start) * 1000.0 << " ms" << std::endl;
+    }
+
+    out << std::defaultfloat << std::setprecision(6);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+#include <ostream>
+#include <stdexcept>
+
+#include "ThreadPool.h"
+
+typedef uint32_t JobId;
+
+enum class JobThread {
+	MAIN, // the thread that calls run, for work that has to stay there (window system, shared command buffers)
+	WORKER // any thread of the pool
+};
+
+// Steps with dependencies between them, each started as soon as the steps it depends on are done. Main thread steps run
+// one at a time in the order they became ready, worker steps run on the pool alongside them.
+// Every step is timed, so after a run the report shows where the time went and which chain of steps the run waited on.
+class JobGraph {
+
+private:
+	struct Job {
+		std::string name;
+		JobThread thread;
+		std::function<void()> work;
+		std::vector<JobId> dependencies;
+		std::vector<JobId> dependents;
+
+		uint32_t waitingOn; // dependencies not finished yet
+		double start; // seconds since run started
+		double end;
+		JobId previousOnMain; // the main thread step that ran right before this one, itself if none did
+	};
+
+	std::vector<Job> jobs;
+
+	// the step that finished last among what job had to wait for, job itself if it didn't wait
+	JobId criticalPredecessor(JobId job);
+
+public:
+	// dependencies have to be added first, which also keeps the graph free of cycles
+	JobId add(const std::string& name, JobThread thread, std::function<void()> work, const std::vector<JobId>& dependencies = {});
+
+	// blocks until every step ran. If one throws nothing new is started, and once the steps already running are done the
+	// first exception is rethrown. Never call it from inside a pool job
+	void run(ThreadPool* threadPool);
+
+	// each step's thread, start and duration, with the critical path marked
+	void printReport(std::ostream& out);
+};
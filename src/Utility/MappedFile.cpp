@@ -0,0 +1,143 @@
+#include "MappedFile.h"
+
+#include <filesystem>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::MappedFile()
+{
+    mapping = nullptr;
+    fileSize = 0;
+
+#ifdef _WIN32
+    fileHandle = nullptr;
+    mappingHandle = nullptr;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE fileMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+    if (fileMapping == nullptr)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    const void* view = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+
+    if (view == nullptr)
+    {
+        CloseHandle(fileMapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = fileMapping;
+    mapping = view;
+    fileSize = static_cast<size_t>(size.QuadPart);
+#else
+    int file = ::open(path.c_str(), O_RDONLY);
+
+    if (file < 0)
+    {
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size == 0)
+    {
+        ::close(file);
+        return false;
+    }
+
+    void* view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+
+    // the mapping keeps the file alive on its own
+    ::close(file);
+
+    if (view == MAP_FAILED)
+    {
+        return false;
+    }
+
+    mapping = view;
+    fileSize = static_cast<size_t>(status.st_size);
+#endif
+
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mapping == nullptr)
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(mapping);
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    munmap(const_cast<void*>(mapping), fileSize);
+#endif
+
+    mapping = nullptr;
+    fileSize = 0;
+}
+
+bool MappedFile::isUpToDate(const std::string& source, const std::string& derived)
+{
+    std::error_code error;
+
+    std::filesystem::file_time_type derivedTime = std::filesystem::last_write_time(derived, error);
+    if (error)
+    {
+        return false;
+    }
+
+    std::filesystem::file_time_type sourceTime = std::filesystem::last_write_time(source, error);
+    if (error)
+    {
+        return true;
+    }
+
+    return derivedTime >= sourceTime;
+}
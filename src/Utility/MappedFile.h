@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// Read only view of a whole file through the os page cache (mmap / file mapping). Nothing is read until it's touched and
+// nothing is copied, so baked assets can be used straight from the mapping.
+class MappedFile {
+
+private:
+	const void* mapping;
+	size_t fileSize;
+
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#endif
+
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// false if the file doesn't exist, is empty or can't be mapped
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() { return mapping != nullptr; }
+	const void* data() { return mapping; }
+	size_t size() { return fileSize; }
+
+	// true if derived exists and was written after source. A missing source counts as up to date, only the derived file shipped
+	static bool isUpToDate(const std::string& source, const std::string& derived);
+};
@@ -160,6 +160,40 @@ Matrix4 Matrix4::flipped()
 	return returnMatrix;
 }
 
+/// <summary>
+/// Transforms a point, translation included. Rows of this matrix are glsl's columns, same as the shaders see it.
+/// </summary>
+/// <param name="point">Point to transform.</param>
+/// <returns>Transformed point.</returns>
+Vector3 Matrix4::transformPoint(const Vector3& point) const
+{
+	Vector3 returnVec = transformDirection(point);
+
+	for (int i = 0; i < 3; ++i)
+	{
+		returnVec[i] += mat[12 + i];
+	}
+
+	return returnVec;
+}
+
+/// <summary>
+/// Transforms a direction, without translation.
+/// </summary>
+/// <param name="direction">Direction to transform.</param>
+/// <returns>Transformed direction, not normalized.</returns>
+Vector3 Matrix4::transformDirection(const Vector3& direction) const
+{
+	Vector3 returnVec;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		returnVec[i] = (mat[i] * direction[0]) + (mat[4 + i] * direction[1]) + (mat[8 + i] * direction[2]);
+	}
+
+	return returnVec;
+}
+
 Matrix4 Matrix4::axisAngle(Vector3 axis, float angle)
 {
 	//from https://en.wikipedia.org/wiki/Rotation_matrix#Rotation_matrix_from_axis_and_angle
@@ -28,6 +28,9 @@ public:
 
 	Matrix4 flipped();
 
+	Vector3 transformPoint(const Vector3& point) const;
+	Vector3 transformDirection(const Vector3& direction) const;
+
 	static Matrix4 axisAngle(Vector3 axis, float angle);
 	static Matrix4 lookAt(Vector3 eye, Vector3 at, Vector3 up);
 	static Matrix4 project(float angle, float aspect, float near, float far);
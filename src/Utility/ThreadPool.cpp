@@ -0,0 +1,159 @@
+#include "ThreadPool.h"
+
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+    busy = 0;
+    stopping = false;
+
+    if (threadCount == 0)
+    {
+        uint32_t cores = std::thread::hardware_concurrency();
+        threadCount = cores > 1 ? cores - 1 : 1;
+    }
+
+    for (uint32_t i = 0; i < threadCount; i++)
+    {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+
+}
+
+void ThreadPool::workerLoop()
+{
+    while (true)
+    {
+        std::function<void()> job;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+
+            if (jobs.empty())
+            {
+                return; // stopping and drained
+            }
+
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            busy++;
+        }
+
+        job();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busy--;
+
+            if (busy == 0 && jobs.empty())
+            {
+                idle.notify_all();
+            }
+        }
+    }
+}
+
+bool ThreadPool::runQueuedJob()
+{
+    std::function<void()> job;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (jobs.empty())
+        {
+            return false;
+        }
+
+        job = std::move(jobs.front());
+        jobs.pop_front();
+        busy++;
+    }
+
+    job();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        busy--;
+
+        if (busy == 0 && jobs.empty())
+        {
+            idle.notify_all();
+        }
+    }
+
+    return true;
+}
+
+void ThreadPool::enqueue(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (stopping)
+        {
+            throw std::runtime_error("thread pool is shutting down!");
+        }
+
+        jobs.push_back(std::move(job));
+    }
+
+    wake.notify_one();
+}
+
+void ThreadPool::parallelFor(uint32_t count, const std::function<void(uint32_t)>& job)
+{
+    std::vector<std::future<void>> futures;
+    futures.reserve(count);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        futures.push_back(submit([&job, i]() { job(i); }));
+    }
+
+    // wait for all of them before rethrowing, the jobs reference the caller's stack.
+    // Helping rather than just waiting means a caller that is itself a job can't leave every worker blocked on jobs
+    // nobody is left to run. Once the queue is empty the rest are running somewhere and a plain wait is fine
+    for (std::future<void>& future : futures)
+    {
+        while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            if (!runQueuedJob())
+            {
+                future.wait();
+            }
+        }
+    }
+
+    for (std::future<void>& future : futures)
+    {
+        future.get();
+    }
+}
+
+void ThreadPool::waitIdle()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this]() { return busy == 0 && jobs.empty(); });
+}
+
+void ThreadPool::destroyThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    wake.notify_all();
+
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+
+    workers.clear();
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <stdexcept>
+
+// Fixed set of worker threads pulling jobs off one queue. For cpu heavy loading work (decoding, parsing) that shouldn't
+// run on the main thread; nothing in here may touch Vulkan objects the main thread is using.
+class ThreadPool {
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable idle;
+	uint32_t busy;
+	bool stopping;
+
+	void workerLoop();
+	// pops one queued job and runs it on the calling thread, false if the queue was empty
+	bool runQueuedJob();
+
+public:
+	// 0 picks one thread per core, minus the main thread
+	ThreadPool(uint32_t threadCount = 0);
+	~ThreadPool();
+
+	void enqueue(std::function<void()> job);
+
+	// runs job on a worker, the future holds its result (or the exception it threw)
+	template<typename F>
+	auto submit(F job) -> std::future<decltype(job())>
+	{
+		typedef decltype(job()) Result;
+
+		std::shared_ptr<std::packaged_task<Result()>> task = std::make_shared<std::packaged_task<Result()>>(std::move(job));
+		std::future<Result> future = task->get_future();
+
+		enqueue([task]() { (*task)(); });
+
+		return future;
+	}
+
+	// runs job(0) .. job(count - 1) on the workers and returns once they're all done, rethrowing the first exception.
+	// The caller runs queued jobs while it waits, so it's safe to call from inside a job too
+	void parallelFor(uint32_t count, const std::function<void(uint32_t)>& job);
+
+	// blocks until the queue is empty and no job is running
+	void waitIdle();
+
+	uint32_t getThreadCount() { return static_cast<uint32_t>(workers.size()); }
+
+	// runs whatever is still queued, then joins the workers
+	void destroyThreadPool();
+};
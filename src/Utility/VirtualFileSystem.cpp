@@ -0,0 +1,214 @@
+#include "VirtualFileSystem.h"
+
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+
+const uint32_t PACK_VERSION = 1;
+const uint64_t PACK_ALIGNMENT = 64; // covers every header and blob the loaders read in place, and spir-v's 4 bytes
+
+// layout of a .dlpack file: this header, the files' contents at aligned offsets, then the table of contents and the names
+struct PackHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t namesSize;
+    uint64_t tocOffset;
+    uint64_t namesOffset;
+};
+
+struct PackTocEntry {
+    uint64_t offset;
+    uint64_t size;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+};
+
+// size bytes at offset are inside a file of fileSize bytes, without the sum wrapping around
+static bool blobFits(uint64_t offset, uint64_t size, uint64_t fileSize)
+{
+    return offset <= fileSize && size <= fileSize - offset;
+}
+
+
+std::string VirtualFileSystem::normalize(const std::string& path)
+{
+    std::string normalized = path;
+
+    for (char& c : normalized)
+    {
+        if (c == '\\')
+        {
+            c = '/';
+        }
+    }
+
+    while (normalized.compare(0, 2, "./") == 0)
+    {
+        normalized.erase(0, 2);
+    }
+
+    return normalized;
+}
+
+bool VirtualFileSystem::mount(const std::string& archivePath)
+{
+    unmount();
+
+    if (!archive.open(archivePath))
+    {
+        return false;
+    }
+
+    const unsigned char* bytes = (const unsigned char*)archive.data();
+    const PackHeader* header = (const PackHeader*)bytes;
+
+    // checked once here, so lookups can trust every entry
+    bool valid = archive.size() >= sizeof(PackHeader) && memcmp(header->magic, "DLPK", 4) == 0 && header->version == PACK_VERSION
+        && blobFits(header->tocOffset, (uint64_t)header->entryCount * sizeof(PackTocEntry), archive.size())
+        && blobFits(header->namesOffset, header->namesSize, archive.size());
+
+    const PackTocEntry* toc = valid ? (const PackTocEntry*)(bytes + header->tocOffset) : nullptr;
+
+    for (uint32_t i = 0; valid && i < header->entryCount; i++)
+    {
+        valid = blobFits(toc[i].offset, toc[i].size, archive.size()) && blobFits(toc[i].nameOffset, toc[i].nameLength, header->namesSize);
+
+        if (valid)
+        {
+            std::string name((const char*)bytes + header->namesOffset + toc[i].nameOffset, toc[i].nameLength);
+            entries[name] = PackEntry{ toc[i].offset, toc[i].size };
+        }
+    }
+
+    if (!valid)
+    {
+        unmount();
+        return false;
+    }
+
+    return true;
+}
+
+void VirtualFileSystem::unmount()
+{
+    entries.clear();
+    archive.close();
+}
+
+bool VirtualFileSystem::isPacked(const std::string& path)
+{
+    return !entries.empty() && entries.count(normalize(path)) != 0;
+}
+
+FileView VirtualFileSystem::open(const std::string& path, MappedFile& looseFile)
+{
+    FileView view;
+
+    if (!entries.empty())
+    {
+        std::unordered_map<std::string, PackEntry>::iterator entry = entries.find(normalize(path));
+
+        if (entry != entries.end())
+        {
+            view.data = (const unsigned char*)archive.data() + entry->second.offset;
+            view.size = static_cast<size_t>(entry->second.size);
+            return view;
+        }
+    }
+
+    if (looseFile.open(path))
+    {
+        view.data = (const unsigned char*)looseFile.data();
+        view.size = looseFile.size();
+    }
+
+    return view;
+}
+
+void VirtualFileSystem::writeArchive(const std::string& archivePath, const std::vector<std::string>& paths)
+{
+    std::vector<PackTocEntry> toc;
+    std::string names;
+
+    // written aside and moved into place, so a half written archive is never mounted
+    std::string temporaryPath = archivePath + ".tmp";
+
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+
+        if (!file.is_open())
+        {
+            throw std::runtime_error("failed to write pack archive!");
+        }
+
+        PackHeader header{};
+        file.write((const char*)&header, sizeof(header));
+
+        uint64_t offset = sizeof(header);
+        const char padding[PACK_ALIGNMENT] = {};
+
+        for (const std::string& path : paths)
+        {
+            MappedFile source;
+            uint64_t size = 0;
+
+            // an empty file can't be mapped, it's packed as an entry of size 0
+            if (source.open(path))
+            {
+                size = source.size();
+            }
+            else
+            {
+                std::error_code error;
+
+                if (!std::filesystem::is_regular_file(path, error) || std::filesystem::file_size(path, error) != 0 || error)
+                {
+                    throw std::runtime_error("failed to open " + path + "!");
+                }
+            }
+
+            uint64_t aligned = ((offset + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT) * PACK_ALIGNMENT;
+            file.write(padding, static_cast<std::streamsize>(aligned - offset));
+
+            if (size != 0)
+            {
+                file.write((const char*)source.data(), static_cast<std::streamsize>(size));
+            }
+
+            std::string name = normalize(path);
+
+            PackTocEntry entry{};
+            entry.offset = aligned;
+            entry.size = size;
+            entry.nameOffset = static_cast<uint32_t>(names.size());
+            entry.nameLength = static_cast<uint32_t>(name.size());
+            toc.push_back(entry);
+
+            names += name;
+            offset = aligned + size;
+        }
+
+        uint64_t tocOffset = ((offset + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT) * PACK_ALIGNMENT;
+        file.write(padding, static_cast<std::streamsize>(tocOffset - offset));
+        file.write((const char*)toc.data(), static_cast<std::streamsize>(sizeof(PackTocEntry) * toc.size()));
+        file.write(names.data(), static_cast<std::streamsize>(names.size()));
+
+        memcpy(header.magic, "DLPK", 4);
+        header.version = PACK_VERSION;
+        header.entryCount = static_cast<uint32_t>(toc.size());
+        header.namesSize = static_cast<uint32_t>(names.size());
+        header.tocOffset = tocOffset;
+        header.namesOffset = tocOffset + sizeof(PackTocEntry) * toc.size();
+
+        file.seekp(0);
+        file.write((const char*)&header, sizeof(header));
+
+        if (!file)
+        {
+            throw std::runtime_error("failed to write pack archive!");
+        }
+    }
+
+    std::filesystem::rename(temporaryPath, archivePath);
+}
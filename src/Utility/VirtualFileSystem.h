@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdexcept>
+
+#include "MappedFile.h"
+
+// Bytes of one file, a range of the archive's mapping or of a loose file's own. Like a span it doesn't own them.
+struct FileView {
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+
+	bool isValid() const { return data != nullptr; }
+};
+
+// Files by relative path. A mounted .dlpack archive is mapped once and every file in it is a view into that mapping, so
+// loading costs no opens, reads or copies. Paths that aren't packed are mapped as loose files, which in development is
+// all of them. Mount before loading anything, lookups are safe from any thread after that.
+class VirtualFileSystem {
+
+private:
+	struct PackEntry {
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	MappedFile archive;
+	std::unordered_map<std::string, PackEntry> entries;
+
+	// "./a\b" and "a/b" are the same file
+	static std::string normalize(const std::string& path);
+
+public:
+	// false if the archive is missing or not one this build can read, everything then comes from loose files
+	bool mount(const std::string& archivePath);
+	void unmount();
+
+	bool isMounted() { return archive.isOpen(); }
+	bool isPacked(const std::string& path);
+
+	// the packed file, otherwise looseFile mapped over the file on disk. Invalid when it's neither
+	FileView open(const std::string& path, MappedFile& looseFile);
+
+	// packs every path into one archive, each file aligned so its contents can be used in place
+	static void writeArchive(const std::string& archivePath, const std::vector<std::string>& paths);
+};
@@ -1,12 +1,25 @@
 #define STB_IMAGE_IMPLEMENTATION
-#define TINYOBJLOADER_IMPLEMENTATION
 
 #include "Graphics/DLPipeline.h"
 
 
 
 
-int main() {
+int main(int argc, char** argv) {
+    // DL_Engine --pack <archive> <files...> bundles the files for a shipping build instead of running
+    if (argc >= 3 && std::string(argv[1]) == "--pack")
+    {
+        try {
+            VirtualFileSystem::writeArchive(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        return EXIT_SUCCESS;
+    }
+
     DLPipeline app;
 
     // UPGRADEME add update, render, physics functions